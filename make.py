@@ -7,7 +7,9 @@ p.add_argument('-c', '--compiler', help='Compiler', choices=['cc', 'gcc', 'clang
 p.add_argument('-o', '--output', help='Output file', default='')
 p.add_argument('-d', '--debug', action='store_true', help='Debug compile')
 p.add_argument('-s', '--static', action='store_true', help='Static compile')
-p.add_argument('-t', '--task', help='Task to run', choices=['main', 'test', 'engine', 'clean', 'format'], default='main')
+p.add_argument('-b', '--bmi2', action='store_true', help='Use BMI2 instructions (pdep) to unpack samples')
+p.add_argument('-z', '--zlib', action='store_true', help='Use zlib to compress .gz output files')
+p.add_argument('-t', '--task', help='Task to run', choices=['main', 'test', 'engine', 'samples', 'perft', 'clean', 'format'], default='main')
 args = p.parse_args()
 
 # Determine flags for: compilation, warning, and linking
@@ -20,6 +22,10 @@ if 'clang' in args.compiler:
 
 lflags ='-lpthread -lm'
 if args.static: lflags += ' -static'
+if args.bmi2: cflags += ' -mbmi2'
+if args.zlib:
+    cflags += ' -DUSE_ZLIB'
+    lflags += ' -lz'
 
 def run(cmd):
     print('% ' + cmd)
@@ -28,15 +34,20 @@ def run(cmd):
 def compile(program, output):
     sources = 'src/bitboard.c src/gen.c src/position.c src/str.c src/util.c src/vec.c'
     if program == 'main':
-        sources += ' src/engine.c src/game.c src/jobs.c src/main.c src/openings.c src/options.c' \
-            ' src/seqwriter.c src/sprt.c src/workers.c'
+        sources += ' src/dedup.c src/engine.c src/game.c src/gzip.c src/ioloop.c src/jobs.c src/main.c' \
+            ' src/openings.c src/options.c src/rating.c src/seqwriter.c src/shardwriter.c' \
+            ' src/samples.c src/sprt.c src/workers.c'
     elif program == 'engine':
         sources += ' test/engine.c'
+    elif program == 'perft':
+        sources += ' test/perft.c'
+    elif program == 'samples':
+        sources += ' src/gzip.c src/samples.c src/seqwriter.c src/shardwriter.c tools/samples.c'
 
     return run('{} {} {} {} -o {} {}'.format(args.compiler, cflags, wflags, sources, output, lflags))
 
 def clean():
-    run('rm -f c-chess-cli c-chess-cli.1.log log out1.pgn out2.pgn stdout test/engine training.csv')
+    run('rm -f c-chess-cli c-chess-samples c-chess-cli.1.log out1.pgn out2.pgn out3.pgn out4.pgn stdout test/engine test/perft training.csv')
 
 if args.task == 'clean':
     clean()
@@ -59,12 +70,19 @@ elif args.task == 'test':
             '-sample freq=0.5 decay=0.05 resolve=y file=training.csv format=csv '
             '-openings file=test/chess960.epd -repeat '
             '-rounds 3 -games 30 -resign number=35 count=5 score=8192 -pgn out2.pgn 2 -log > stdout')
-        run('grep -v ^deadline c-chess-cli.1.log > log')
+
+        # Engine pool: engines switch pairs, and must outlive the workers that finish first
+        pool = ('./c-chess-cli -each cmd=./test/engine depth=4 -engine name=a -engine name=b '
+            '-engine name=c -engine name=d -openings file=test/chess960.epd -games 10 -rounds 2 '
+            '-concurrency 3 -pgn {} > /dev/null')
+        run(pool.format('out3.pgn 2 -affinity -enginepool 4'))
+        run(pool.format('out4.pgn 2'))
+        run('cmp out3.pgn out4.pgn')
 
         print('\nFile signatures:')
-        run('sha1sum stdout out1.pgn out2.pgn log training.csv')
+        run('sha1sum stdout out1.pgn out2.pgn c-chess-cli.1.log training.csv')
         print('\nOverall signature:')
-        run('cat stdout out1.pgn out2.pgn log training.csv |sha1sum')
+        run('cat stdout out1.pgn out2.pgn c-chess-cli.1.log training.csv |sha1sum')
 
 elif args.task == 'main':
     if args.output == '': args.output = './c-chess-cli'
@@ -73,3 +91,12 @@ elif args.task == 'main':
 elif args.task == 'engine':
     if args.output == '': args.output = './test/engine'
     compile(args.task, args.output)
+
+elif args.task == 'perft':
+    if args.output == '': args.output = './test/perft'
+    if compile(args.task, args.output) == 0:
+        run('{} -threads {} test/perft.epd'.format(args.output, os.cpu_count()))
+
+elif args.task == 'samples':
+    if args.output == '': args.output = './c-chess-samples'
+    compile(args.task, args.output)
@@ -0,0 +1,110 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "dedup.h"
+#include "util.h"
+#ifdef __MINGW32__
+    #include <malloc.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+enum { DEDUP_WAYS = 8 }; // one 64-byte cache line per bucket
+
+// Allocate the keys of 'buckets' buckets, each aligned on a cache line, and uninitialized
+static uint64_t *dedup_alloc(size_t buckets) {
+    const size_t bytes = buckets * DEDUP_WAYS * sizeof(uint64_t);
+#ifdef __MINGW32__
+    uint64_t *keys = _aligned_malloc(bytes, 64);
+#else
+    uint64_t *keys = aligned_alloc(64, bytes);
+#endif
+    DIE_IF(!keys);
+    return keys;
+}
+
+Dedup dedup_init(size_t bytes) {
+    // Largest power of 2 number of buckets that fits in the budget
+    size_t buckets = 1;
+
+    while (buckets * 2 * DEDUP_WAYS * sizeof(uint64_t) <= bytes)
+        buckets *= 2;
+
+    Dedup d = {.keys = dedup_alloc(buckets), .mask = buckets - 1};
+    memset(d.keys, 0, buckets * DEDUP_WAYS * sizeof(uint64_t));
+    return d;
+}
+
+void dedup_destroy(Dedup *d) {
+#ifdef __MINGW32__
+    _aligned_free(d->keys);
+#else
+    free(d->keys);
+#endif
+}
+
+Dedup dedup_snapshot(const Dedup *d) {
+    Dedup s = {.keys = dedup_alloc(d->mask + 1),
+               .mask = d->mask,
+               .kept = __atomic_load_n(&d->kept, __ATOMIC_RELAXED),
+               .dropped = __atomic_load_n(&d->dropped, __ATOMIC_RELAXED)};
+    memcpy(s.keys, d->keys, (d->mask + 1) * DEDUP_WAYS * sizeof(uint64_t));
+    return s;
+}
+
+bool dedup_insert(Dedup *d, uint64_t key) {
+    key = key ? key : 1; // 0 marks empty slots
+    uint64_t *bucket = &d->keys[(key & d->mask) * DEDUP_WAYS];
+    int i = 0;
+
+    // Slots are filled in order, and never emptied
+    for (; i < DEDUP_WAYS; i++) {
+        uint64_t slot = __atomic_load_n(&bucket[i], __ATOMIC_RELAXED);
+
+        // Claim an empty slot. If another thread was faster, check the key it wrote.
+        if (!slot && __atomic_compare_exchange_n(&bucket[i], &slot, key, false, __ATOMIC_RELAXED,
+                                                 __ATOMIC_RELAXED))
+            break;
+
+        if (slot == key) {
+            __atomic_fetch_add(&d->dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    }
+
+    // Bucket is full: replace a key, chosen by bits not used to index the bucket
+    if (i == DEDUP_WAYS)
+        __atomic_store_n(&bucket[key >> 61], key, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&d->kept, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void dedup_save(const Dedup *d, FILE *out) {
+    const size_t count = (d->mask + 1) * DEDUP_WAYS;
+    DIE_IF(fprintf(out, "dedup %zu %zu %zu\n", count, d->kept, d->dropped) < 0);
+    DIE_IF(fwrite(d->keys, sizeof(uint64_t), count, out) != count);
+}
+
+void dedup_load(Dedup *d, FILE *in) {
+    size_t count = 0;
+
+    if (fscanf(in, " dedup %zu %zu %zu", &count, &d->kept, &d->dropped) != 3 || fgetc(in) != '\n')
+        DIE("invalid checkpoint\n");
+
+    if (count != (d->mask + 1) * DEDUP_WAYS)
+        DIE("dedup size differs from the checkpoint\n");
+
+    DIE_IF(fread(d->keys, sizeof(uint64_t), count, in) != count);
+}
@@ -0,0 +1,40 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Set of position keys shared by all workers, to drop duplicate samples. Lock free, with a fixed
+// memory budget: when a bucket is full, a key is replaced, so that duplicates of forgotten keys can
+// get through, but a position is never dropped unless its key was seen before.
+typedef struct {
+    uint64_t *keys;       // buckets of DEDUP_WAYS keys (0 for an empty slot)
+    size_t mask;          // number of buckets - 1
+    size_t kept, dropped; // counters (atomic)
+} Dedup;
+
+Dedup dedup_init(size_t bytes);
+void dedup_destroy(Dedup *d);
+
+// Insert key, and return false if it was already present
+bool dedup_insert(Dedup *d, uint64_t key);
+
+// Copy of the table, to be taken while no key is inserted, and saved later (see main_checkpoint())
+Dedup dedup_snapshot(const Dedup *d);
+
+void dedup_save(const Dedup *d, FILE *out);
+void dedup_load(Dedup *d, FILE *in);
@@ -19,15 +19,18 @@
 #elif defined __linux__
     #define _GNU_SOURCE
     #include <fcntl.h>
+    #include <poll.h>
     #include <sys/prctl.h>
     #include <sys/wait.h>
     #include <unistd.h>
 #else
+    #include <poll.h>
     #include <sys/wait.h>
     #include <unistd.h>
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <pthread.h>
 #include <signal.h>
@@ -36,9 +39,12 @@
 #include <string.h>
 
 #include "engine.h"
+#include "ioloop.h"
 #include "util.h"
 #include "vec.h"
 
+enum { READ_CHUNK = 4096 };
+
 #ifdef __MINGW32__
 // Spawning sub-processes must be sequential on Windows, for (at least) 2 reasons:
 // (1) handle inheritance bug as CreatePipe() and stuff are racy
@@ -124,12 +130,11 @@ static void engine_spawn(Engine *e, const char *cwd, char **argv, bool readStdEr
     // Close the handle to the child's primary thread
     DIE_IF(!CloseHandle(piProcInfo.hThread));
 
-    // Reopen stdin and stdout pipes using C style FILE
+    // Reopen stdin pipe using C style FILE, and keep a file descriptor for the stdout pipe
     int stdin_fd = _open_osfhandle((intptr_t)into[1], _O_WRONLY | _O_TEXT);
-    int stdout_fd = _open_osfhandle((intptr_t)outof[0], _O_RDONLY | _O_TEXT);
+    e->in = _open_osfhandle((intptr_t)outof[0], _O_RDONLY | _O_TEXT);
     DIE_IF(stdin_fd == -1);
-    DIE_IF(stdout_fd == -1);
-    DIE_IF(!(e->in = _fdopen(stdout_fd, "r")));
+    DIE_IF(e->in == -1);
     DIE_IF(!(e->out = _fdopen(stdin_fd, "w")));
 
 #else // POSIX: Linux/Android == __linux__, otherwise assume __APPLE__
@@ -151,6 +156,7 @@ static void engine_spawn(Engine *e, const char *cwd, char **argv, bool readStdEr
     #ifdef __linux__
         prctl(PR_SET_PDEATHSIG, SIGHUP); // delegate zombie purge to the kernel
     #endif
+        signal(SIGPIPE, SIG_DFL); // ignored by the parent (see main_init()), but inherited by exec
         // Plug stdin and stdout
         DIE_IF(dup2(into[0], STDIN_FILENO) < 0);
         DIE_IF(dup2(outof[1], STDOUT_FILENO) < 0);
@@ -183,7 +189,7 @@ static void engine_spawn(Engine *e, const char *cwd, char **argv, bool readStdEr
         DIE_IF(close(into[0]) < 0);
         DIE_IF(close(outof[1]) < 0);
 
-        DIE_IF(!(e->in = fdopen(outof[0], "r")));
+        e->in = outof[0];
         DIE_IF(!(e->out = fdopen(into[1], "w")));
     }
 #endif
@@ -238,6 +244,7 @@ Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *op
         DIE("[%d] missing command to start engine.\n", threadId);
 
     Engine e = {.name = str_init_from_c(*name ? name : cmd), // default value
+                .vecRead = vec_init_reserve(READ_CHUNK, char),
                 .timeOut = timeOut};
 
     // Parse cmd into (cwd, run, vecArgs): we want to execute run from cwd with vecArgs.
@@ -254,16 +261,22 @@ Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *op
     // Spawn child process and plug pipes
     engine_spawn(&e, cwd.buf, argv, w->log != NULL);
 
+    if (w->task)
+        io_nonblocking(e.in);
+
     vec_destroy_rec(vecArgs, str_destroy);
     free(argv);
 
     // Start the uci..uciok dialogue
-    deadline_set(w, e.name.buf, system_msec(), e.timeOut);
     engine_writeln(w, &e, "uci");
-    scope(str_destroy) str_t line = str_init();
+    str_t line;
+    const int64_t timeLimit = system_msec() + e.timeOut;
 
     do {
-        engine_readln(w, &e, &line);
+        if (!engine_readln(w, &e, &line, timeLimit))
+            DIE("[%d] engine %s %s during uci..uciok dialogue\n", threadId, e.name.buf,
+                e.eof ? "terminated" : "is unresponsive");
+
         const char *tail = NULL;
 
         // If no name was provided, parse it from "id name %s"
@@ -274,19 +287,14 @@ Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *op
             e.supportChess960 = true;
     } while (strcmp(line.buf, "uciok"));
 
-    deadline_clear(w);
-
     for (size_t i = 0; i < vec_size(options); i++) {
-        scope(str_destroy) str_t oname = str_init(), ovalue = str_init();
+        scope(str_destroy) str_t oname = str_init(), ovalue = str_init(), setoption = str_init();
         const char *tail = NULL;
 
         if ((tail = str_tok_esc(options[i].buf, &oname, '=', ESC_SEQ)) &&
             (tail = str_tok_esc(tail, &ovalue, '=', ESC_SEQ))) {
-            str_cpy_fmt(&line, "setoption name %S value %S", oname, ovalue);
-
-            deadline_set(w, e.name.buf, system_msec(), e.timeOut);
-            engine_writeln(w, &e, line.buf);
-            deadline_clear(w);
+            str_cpy_fmt(&setoption, "setoption name %S value %S", oname, ovalue);
+            engine_writeln(w, &e, setoption.buf);
         } else
             DIE("Cannot parse '%s'\n", options[i].buf);
     }
@@ -294,41 +302,158 @@ Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *op
     return e;
 }
 
+// Waits until e->in is readable (returns true), or timeLimit is reached (returns false)
+static bool engine_wait(Worker *w, const Engine *e, int64_t timeLimit) {
+    const int fd = e->in;
+
+    if (w->task)
+        return io_wait(w, fd, timeLimit);
+
+#ifdef __MINGW32__
+    // No poll() for pipes on Windows: spin on PeekNamedPipe() instead. On error (eg. broken pipe)
+    // return true, and let read() report it.
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    DWORD available = 0;
+
+    while (PeekNamedPipe(h, NULL, 0, NULL, &available, NULL) && !available) {
+        if (system_msec() >= timeLimit)
+            return false;
+
+        Sleep(1);
+    }
+
+    return true;
+#else
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    for (;;) {
+        const int64_t remaining = max(timeLimit - system_msec(), (int64_t)0);
+        const int ret = poll(&pfd, 1, (int)min(remaining, (int64_t)INT_MAX));
+
+        if (ret > 0)
+            return true;
+        else if (ret == 0 && remaining <= INT_MAX)
+            return false;
+
+        DIE_IF(ret < 0 && errno != EINTR);
+    }
+#endif
+}
+
+// Reads large chunks from the pipe into vecRead, until a full line is available. The line is not
+// copied: it is '\0' terminated in place, and returned as a view. Returns false on time out or EOF.
+static bool engine_getline(Worker *w, Engine *e, str_t *line, int64_t timeLimit) {
+    size_t scanned = e->readPos;
+    char *lf;
+
+    while (!(lf = memchr(e->vecRead + scanned, '\n', vec_size(e->vecRead) - scanned))) {
+        if (e->eof || !engine_wait(w, e, timeLimit))
+            return false;
+
+        // Discard consumed bytes, so that only the incomplete line is moved (if any)
+        if (e->readPos) {
+            const size_t pending = vec_size(e->vecRead) - e->readPos;
+            memmove(e->vecRead, e->vecRead + e->readPos, pending);
+            vec_ptr(e->vecRead)->size = pending;
+            e->readPos = 0;
+        }
+
+        scanned = vec_size(e->vecRead);
+
+        if (vec_capacity(e->vecRead) - scanned < READ_CHUNK)
+            e->vecRead = vec_do_grow(e->vecRead, sizeof(char), READ_CHUNK);
+
+        const ssize_t n = read(e->in, e->vecRead + scanned, vec_capacity(e->vecRead) - scanned);
+
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            continue; // spurious wake up (event driven mode), or signal
+
+        DIE_IF(n < 0);
+
+        if (n == 0) {
+            e->eof = true;
+            return false;
+        }
+
+        vec_ptr(e->vecRead)->size += (size_t)n;
+    }
+
+    // Return a view of the line, after discarding '\n' (and '\r' of Windows encoded CR+LF)
+    char *const begin = e->vecRead + e->readPos;
+    size_t len = (size_t)(lf - begin);
+
+    if (len && begin[len - 1] == '\r')
+        len--;
+
+    begin[len] = '\0';
+    *line = (str_t){.buf = begin, .len = len, .alloc = len + 1};
+    e->readPos = (size_t)(lf + 1 - e->vecRead);
+    return true;
+}
+
+// Flag the engine as unresponsive: it will be killed by engine_destroy(), and should be respawned
+static void engine_unresponsive(Worker *w, Engine *e) {
+    e->unresponsive = true;
+    const char *what = e->eof ? "terminated" : "is unresponsive";
+
+    stdio_lock(stdout); // lock both stderr and stdout to prevent interleaving
+    fprintf(stderr, "[%d] WARNING: engine %s %s\n", threadId, e->name.buf, what);
+    stdio_unlock(stdout);
+
+    if (w->log)
+        DIE_IF(fprintf(w->log, "WARNING: engine %s %s\n", e->name.buf, what) < 0);
+}
+
 void engine_destroy(Worker *w, Engine *e) {
     // Engine was not instanciated with engine_init()
-    if (!e->in)
+    if (!e->out)
         return;
 
-    // Order the engine to quit, and grant 1s deadline for obeying
-    deadline_set(w, e->name.buf, system_msec(), e->timeOut);
-    engine_writeln(w, e, "quit");
+    // Order the engine to quit, and grant it timeOut to obey (ie. close its end of the pipe). An
+    // engine that does not, or is already known to be unresponsive, is killed.
+    if (!e->unresponsive) {
+        engine_writeln(w, e, "quit");
+        str_t line;
+        const int64_t timeLimit = system_msec() + e->timeOut;
+
+        while (engine_readln(w, e, &line, timeLimit))
+            ;
+    }
 
 #ifdef __MINGW32__
+    if (!e->eof)
+        TerminateProcess(e->hProcess, 1);
+
     WaitForSingleObject(e->hProcess, INFINITE);
     CloseHandle(e->hProcess);
 #else
+    if (!e->eof)
+        kill(e->pid, SIGKILL);
+
     waitpid(e->pid, NULL, 0);
 #endif
 
-    deadline_clear(w);
-
     str_destroy(&e->name);
-    DIE_IF(fclose(e->in) < 0);
+    vec_destroy(e->vecRead);
+    DIE_IF(close(e->in) < 0);
     DIE_IF(fclose(e->out) < 0);
 }
 
-void engine_readln(const Worker *w, const Engine *e, str_t *line) {
-    if (!str_getline(line, e->in))
-        DIE("[%d] could not read from %s\n", threadId, e->name.buf);
+bool engine_readln(Worker *w, Engine *e, str_t *line, int64_t timeLimit) {
+    if (!engine_getline(w, e, line, timeLimit))
+        return false;
 
     if (w->log)
         DIE_IF(fprintf(w->log, "%s -> %s\n", e->name.buf, line->buf) < 0);
+
+    return true;
 }
 
 void engine_writeln(const Worker *w, const Engine *e, char *buf) {
-    DIE_IF(fputs(buf, e->out) < 0);
-    DIE_IF(fputc('\n', e->out) < 0);
-    DIE_IF(fflush(e->out) < 0);
+    // Writing to a terminated engine fails with EPIPE. This is not fatal: the next read will fail
+    // with EOF, and the engine will be treated as unresponsive.
+    DIE_IF((fputs(buf, e->out) < 0 || fputc('\n', e->out) < 0 || fflush(e->out) < 0) &&
+           errno != EPIPE);
 
     if (w->log) {
         DIE_IF(fprintf(w->log, "%s <- %s\n", e->name.buf, buf) < 0);
@@ -336,87 +461,179 @@ void engine_writeln(const Worker *w, const Engine *e, char *buf) {
     }
 }
 
-void engine_newgame(Worker *w, const Engine *e) {
-    deadline_set(w, e->name.buf, system_msec(), e->timeOut);
-    engine_writeln(w, e, "ucinewgame");
-    deadline_clear(w);
-}
+void engine_newgame(const Worker *w, const Engine *e) { engine_writeln(w, e, "ucinewgame"); }
 
-void engine_sync(Worker *w, const Engine *e) {
-    deadline_set(w, e->name.buf, system_msec(), e->timeOut);
+bool engine_sync(Worker *w, Engine *e) {
     engine_writeln(w, e, "isready");
-    scope(str_destroy) str_t line = str_init();
+    str_t line;
+    const int64_t timeLimit = system_msec() + e->timeOut;
 
     do {
-        engine_readln(w, e, &line);
+        if (!engine_readln(w, e, &line, timeLimit)) {
+            engine_unresponsive(w, e);
+            return false;
+        }
     } while (strcmp(line.buf, "readyok"));
 
-    deadline_clear(w);
+    return true;
+}
+
+// Returns true if info line 'tail' (after "info ") has the token 'name'
+static bool engine_info_has(const char *tail, const char *name) {
+    const size_t len = strlen(name);
+
+    for (const char *s = tail; (s = strstr(s, name)); s += len)
+        if ((s == tail || s[-1] == ' ') && (s[len] == ' ' || !s[len]))
+            return true;
+
+    return false;
 }
 
-static void engine_parse_info(const char *tail, Info *info, str_t *pv) {
+// Parse info line 'tail' (after "info "), setting only the fields that are not NULL
+static void engine_parse_info(const char *tail, int *depth, int *score, str_t *pv) {
     scope(str_destroy) str_t token = str_init();
 
     while ((tail = str_tok(tail, &token, " "))) {
         if (!strcmp(token.buf, "depth")) {
-            if ((tail = str_tok(tail, &token, " ")))
-                info->depth = atoi(token.buf);
+            if ((tail = str_tok(tail, &token, " ")) && depth)
+                *depth = atoi(token.buf);
         } else if (!strcmp(token.buf, "score")) {
             if ((tail = str_tok(tail, &token, " "))) {
+                int value = 0;
+
                 if (!strcmp(token.buf, "cp") && (tail = str_tok(tail, &token, " ")))
-                    info->score = atoi(token.buf);
+                    value = atoi(token.buf);
                 else if (!strcmp(token.buf, "mate") && (tail = str_tok(tail, &token, " "))) {
                     const int movesToMate = atoi(token.buf);
-                    info->score =
-                        movesToMate < 0 ? INT16_MIN - movesToMate : INT16_MAX - movesToMate;
+                    value = movesToMate < 0 ? INT16_MIN - movesToMate : INT16_MAX - movesToMate;
                 } else
                     DIE("%s(): illegal syntax after 'score' here '%s'\n", __func__, tail);
+
+                if (score)
+                    *score = value;
             }
-        } else if (!strcmp(token.buf, "pv"))
+        } else if (!strcmp(token.buf, "pv")) {
             // FIXME: pv really belongs in Info. This means Info must have ctor/dtor, of course. But
             // the benefit is that we can print the PV in the PGN afterwards.
-            str_cpy_c(pv, tail + strspn(tail, " "));
+            if (pv)
+                str_cpy_c(pv, tail + strspn(tail, " "));
+
+            break; // the rest of the line is the pv
+        }
     }
 }
 
-bool engine_bestmove(Worker *w, const Engine *e, int64_t *timeLeft, str_t *best, str_t *pv,
-                     Info *info) {
+bool engine_bestmove(Worker *w, Engine *e, int64_t *timeLeft, str_t *best, str_t *pv, Info *info) {
     int result = false;
-    scope(str_destroy) str_t line = str_init();
+    str_t line;
     str_clear(pv);
 
+    // Only the last depth, score and pv matter. Engines can send thousands of info lines per move
+    // (currmove, nodes, etc.), so we just copy the last line with each of them raw, and parse them
+    // once we have the bestmove.
+    scope(str_destroy) str_t lastDepth = str_init(), lastScore = str_init(), lastPv = str_init();
+
     const int64_t start = system_msec(), timeLimit = start + *timeLeft;
-    deadline_set(w, e->name.buf, start, *timeLeft + e->timeOut);
 
     while (*timeLeft >= 0 && !result) {
-        engine_readln(w, e, &line);
+        const bool read = engine_readln(w, e, &line, timeLimit);
 
         const int64_t now = system_msec();
         info->time = now - start;
         *timeLeft = timeLimit - now;
 
+        if (!read)
+            break;
+
         const char *tail = NULL;
 
-        if ((tail = str_prefix(line.buf, "info ")))
-            engine_parse_info(tail, info, pv);
-        else if ((tail = str_prefix(line.buf, "bestmove "))) {
-            scope(str_destroy) str_t token = str_init();
-            str_tok(tail, &token, " ");
-            str_cpy(best, token);
+        if ((tail = str_prefix(line.buf, "info "))) {
+            if (!str_prefix(tail, "string ")) {
+                if (engine_info_has(tail, "depth"))
+                    str_cpy_c(&lastDepth, tail);
+
+                if (engine_info_has(tail, "score"))
+                    str_cpy_c(&lastScore, tail);
+
+                if (engine_info_has(tail, "pv"))
+                    str_cpy_c(&lastPv, tail);
+            }
+        } else if ((tail = str_prefix(line.buf, "bestmove "))) {
+            str_tok(tail, best, " ");
             result = true;
         }
     }
 
-    // Time out. Send "stop" and give the opportunity to the engine to respond with bestmove (still
-    // under deadline protection).
+    // Time out. Send "stop" and give the opportunity to the engine to respond with bestmove, within
+    // timeOut tolerance. Otherwise, the engine is unresponsive (hung or terminated).
     if (!result) {
         engine_writeln(w, e, "stop");
+        const int64_t stopLimit = system_msec() + e->timeOut;
 
         do {
-            engine_readln(w, e, &line);
+            if (!engine_readln(w, e, &line, stopLimit)) {
+                engine_unresponsive(w, e);
+                break;
+            }
         } while (!str_prefix(line.buf, "bestmove "));
     }
 
-    deadline_clear(w);
+    engine_parse_info(lastDepth.buf, &info->depth, NULL, NULL);
+    engine_parse_info(lastScore.buf, NULL, &info->score, NULL);
+    engine_parse_info(lastPv.buf, NULL, NULL, pv);
+
     return result;
 }
+
+struct PooledEngine {
+    Engine engine;
+    int key;
+};
+
+EnginePool engine_pool_init(size_t cap) {
+    return (EnginePool){.vecIdle = vec_init(struct PooledEngine), .cap = cap};
+}
+
+void engine_pool_destroy(EnginePool *pool) {
+    vec_destroy(pool->vecIdle);
+}
+
+bool engine_pool_get(EnginePool *pool, int key, Engine *e) {
+    for (size_t i = vec_size(pool->vecIdle); i-- > 0;)
+        if (pool->vecIdle[i].key == key) {
+            *e = pool->vecIdle[i].engine;
+            memmove(&pool->vecIdle[i], &pool->vecIdle[i + 1],
+                    (vec_size(pool->vecIdle) - i - 1) * sizeof(struct PooledEngine));
+            vec_ptr(pool->vecIdle)->size--;
+            return true;
+        }
+
+    return false;
+}
+
+void engine_pool_put(EnginePool *pool, Worker *w, int key, Engine *e) {
+    // Ownership is transferred: the caller's copy must not be used anymore
+    Engine returned = *e;
+    *e = (Engine){0};
+
+    if (returned.unresponsive || !pool->cap) {
+        engine_destroy(w, &returned);
+        return;
+    }
+
+    if (vec_size(pool->vecIdle) == pool->cap) {
+        engine_destroy(w, &pool->vecIdle[0].engine);
+        memmove(&pool->vecIdle[0], &pool->vecIdle[1],
+                (vec_size(pool->vecIdle) - 1) * sizeof(struct PooledEngine));
+        vec_ptr(pool->vecIdle)->size--;
+    }
+
+    vec_push(pool->vecIdle, ((struct PooledEngine){.engine = returned, .key = key}));
+}
+
+void engine_pool_drain(EnginePool *pool, Worker *w) {
+    while (vec_size(pool->vecIdle)) {
+        Engine e = vec_pop(pool->vecIdle).engine;
+        engine_destroy(w, &e);
+    }
+}
@@ -14,6 +14,7 @@
  */
 #pragma once
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #ifdef __MINGW32__
@@ -28,7 +29,10 @@
 
 // Engine process
 typedef struct {
-    FILE *in, *out;
+    FILE *out;
+    int in;           // file descriptor, read with engine_readln()
+    char *vecRead;    // read buffer: bytes before readPos are consumed, the rest are pending
+    size_t readPos;
     str_t name;
     int64_t timeOut;
 #ifdef __MINGW32__
@@ -37,6 +41,8 @@ typedef struct {
     pid_t pid;
 #endif
     bool supportChess960;
+    bool eof;          // engine closed its end of the pipe (ie. terminated)
+    bool unresponsive; // timed out or terminated: must be destroyed (killed) and respawned
 } Engine;
 
 // Elements remembered from parsing info lines (for writing PGN comments)
@@ -49,10 +55,33 @@ Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *op
                    int64_t timeOut);
 void engine_destroy(Worker *w, Engine *e);
 
-void engine_readln(const Worker *w, const Engine *e, str_t *line);
+// Sets 'line' to a view of the next line, which is only valid until the next read from 'e'. Returns
+// false if no line could be read before timeLimit (or engine terminated).
+bool engine_readln(Worker *w, Engine *e, str_t *line, int64_t timeLimit);
 void engine_writeln(const Worker *w, const Engine *e, char *buf);
 
-void engine_newgame(Worker *w, const Engine *e);
-void engine_sync(Worker *w, const Engine *e);
-bool engine_bestmove(Worker *w, const Engine *e, int64_t *timeLeft, str_t *best, str_t *pv,
-                     Info *info);
+void engine_newgame(const Worker *w, const Engine *e);
+bool engine_sync(Worker *w, Engine *e);
+bool engine_bestmove(Worker *w, Engine *e, int64_t *timeLeft, str_t *best, str_t *pv, Info *info);
+
+// Pool of idle engines of a worker, so that switching pairs does not respawn engines (fork+exec,
+// uci handshake, setoption). Engines are identified by a key (EngineOptions index). A pool is never
+// shared: on Linux, engines are killed when the thread that spawned them exits (PR_SET_PDEATHSIG).
+typedef struct {
+    struct PooledEngine *vecIdle; // least recently used first
+    size_t cap;                   // maximum number of idle engines
+} EnginePool;
+
+EnginePool engine_pool_init(size_t cap);
+void engine_pool_destroy(EnginePool *pool);
+
+// Take an idle engine out of the pool, if there is one for 'key'
+bool engine_pool_get(EnginePool *pool, int key, Engine *e);
+
+// Give an engine back to the pool (and zero *e). It is destroyed instead, if it is unresponsive, or
+// the pool has no capacity. When the pool is full, the least recently used engine is destroyed to
+// make room.
+void engine_pool_put(EnginePool *pool, Worker *w, int key, Engine *e);
+
+// Destroy all idle engines
+void engine_pool_drain(EnginePool *pool, Worker *w);
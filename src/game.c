@@ -163,14 +163,6 @@ Game game_init(int round, int game) {
     return g;
 }
 
-bool game_load_fen(Game *g, const char *fen, int *color) {
-    if (pos_set(&g->vecPos[0], fen, false)) {
-        *color = g->vecPos[0].turn;
-        return true;
-    } else
-        return false;
-}
-
 void game_destroy(Game *g) {
     vec_destroy(g->vecSamples);
     vec_destroy(g->vecInfo);
@@ -179,15 +171,19 @@ void game_destroy(Game *g) {
     str_destroy_n(&g->names[WHITE], &g->names[BLACK]);
 }
 
-int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
-              const EngineOptions *eo[2], bool reverse)
+int game_play(Worker *w, Game *g, const Options *o, Engine engines[2], const EngineOptions *eo[2],
+              bool reverse)
 // Play a game:
 // - engines[reverse] plays the first move (which does not mean white, that depends on the FEN)
 // - sets g->state value: see enum STATE_* codes
-// - returns RESULT_LOSS/DRAW/WIN from engines[0] pov
+// - returns RESULT_LOSS/DRAW/WIN from engines[0] pov, or NB_RESULT if the game could not start
+//   because an engine is unresponsive (g->state remains STATE_NONE)
 {
+    // Opening moves (if any) are already in g->vecPos[]
+    g->bookPly = (int)vec_size(g->vecPos) - 1;
+
     for (int color = WHITE; color <= BLACK; color++)
-        str_cpy(&g->names[color], engines[color ^ g->vecPos[0].turn ^ reverse].name);
+        str_cpy(&g->names[color], engines[color ^ g->vecPos[g->bookPly].turn ^ reverse].name);
 
     for (int i = 0; i < 2; i++) {
         if (g->vecPos[0].chess960) {
@@ -198,7 +194,9 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
         }
 
         engine_newgame(w, &engines[i]);
-        engine_sync(w, &engines[i]);
+
+        if (!engine_sync(w, &engines[i]))
+            return NB_RESULT;
     }
 
     scope(str_destroy) str_t cmd = str_init(), best = str_init();
@@ -210,7 +208,10 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
     scope(str_destroy) str_t pv = str_init();
     move_t *vecLegalMoves = vec_init_reserve(64, move_t);
 
-    for (g->ply = 0;; ei = 1 - ei, g->ply++) {
+    for (int ply = 0; ply < g->bookPly; ply++)
+        vec_push(g->vecInfo, (Info){0});
+
+    for (g->ply = g->bookPly;; ei = 1 - ei, g->ply++) {
         if (played)
             pos_move(&g->vecPos[g->ply], &g->vecPos[g->ply - 1], played);
 
@@ -219,7 +220,11 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
 
         uci_position_command(g, &cmd);
         engine_writeln(w, &engines[ei], cmd.buf);
-        engine_sync(w, &engines[ei]);
+
+        if (!engine_sync(w, &engines[ei])) {
+            g->state = STATE_TIME_LOSS;
+            break;
+        }
 
         // Prepare timeLeft[ei]
         if (eo[ei]->movetime)
@@ -399,7 +404,10 @@ void game_export_pgn(const Game *g, int verbosity, str_t *out) {
             // Write PGN comment
             const int depth = g->vecInfo[ply - 1].depth, score = g->vecInfo[ply - 1].score;
 
-            if (verbosity == 2) {
+            if (ply <= g->bookPly) {
+                if (verbosity >= 2)
+                    str_cat_c(out, " {book}");
+            } else if (verbosity == 2) {
                 if (is_mating(score))
                     str_cat_fmt(out, " {M%i/%i}", INT16_MAX - score, depth);
                 else if (is_mated(score))
@@ -425,33 +433,35 @@ void game_export_pgn(const Game *g, int verbosity, str_t *out) {
     str_cat_c(str_cat(out, result), "\n\n");
 }
 
-static void game_export_samples_csv(const Game *g, FILE *out) {
-    scope(str_destroy) str_t fen = str_init();
+static void game_export_samples_csv(const Game *g, char **vecOut) {
+    scope(str_destroy) str_t line = str_init();
 
     for (size_t i = 0; i < vec_size(g->vecSamples); i++) {
-        pos_get(&g->vecSamples[i].pos, &fen);
-        fprintf(out, "%s,%d,%d\n", fen.buf, g->vecSamples[i].score, g->vecSamples[i].result);
+        pos_get(&g->vecSamples[i].pos, &line);
+        str_cat_fmt(&line, ",%i,%i\n", g->vecSamples[i].score, g->vecSamples[i].result);
+        vec_push_n(*vecOut, line.buf, line.len);
     }
 }
 
-static void game_export_samples_bin(const Game *g, FILE *out) {
+static void game_export_samples_bin(const Game *g, char **vecOut) {
     for (size_t i = 0; i < vec_size(g->vecSamples); i++) {
         PackedPos packed = {0};
         const size_t bytes = pos_pack(&g->vecSamples[i].pos, &packed);
 
-        fwrite(&packed, bytes, 1, out);
-        fwrite(&g->vecSamples[i].score, sizeof(g->vecSamples[i].score), 1, out);
-        fwrite(&g->vecSamples[i].result, sizeof(g->vecSamples[i].result), 1, out);
+        // Saturate the score to int16_t (mate scores already fit)
+        const int s = g->vecSamples[i].score;
+        const int16_t score = (int16_t)(s > INT16_MAX ? INT16_MAX : s < INT16_MIN ? INT16_MIN : s);
+        const uint8_t result = (uint8_t)g->vecSamples[i].result;
+
+        vec_push_n(*vecOut, (const char *)&packed, bytes);
+        vec_push_n(*vecOut, (const char *)&score, sizeof(score));
+        vec_push_n(*vecOut, (const char *)&result, sizeof(result));
     }
 }
 
-void game_export_samples(const Game *g, FILE *out, bool bin) {
-    stdio_lock(out);
-
+void game_export_samples(const Game *g, bool bin, char **vecOut) {
     if (bin)
-        game_export_samples_bin(g, out);
+        game_export_samples_bin(g, vecOut);
     else
-        game_export_samples_csv(g, out);
-
-    stdio_unlock(out);
+        game_export_samples_csv(g, vecOut);
 }
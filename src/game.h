@@ -47,6 +47,7 @@ typedef struct {
 typedef struct {
     str_t names[NB_COLOR]; // names of players, by color
     Position *vecPos;      // list of positions (including moves) since game start
+    int bookPly;           // number of plies played from the opening, before the game starts
     Info *vecInfo;         // remembered from parsing info lines (for PGN comments)
     Sample *vecSamples;    // list of samples when generating training data
     int round, game, ply, state;
@@ -55,11 +56,9 @@ typedef struct {
 Game game_init(int round, int game);
 void game_destroy(Game *g);
 
-bool game_load_fen(Game *g, const char *fen, int *color);
-
-int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
-              const EngineOptions *eo[2], bool reverse);
+int game_play(Worker *w, Game *g, const Options *o, Engine engines[2], const EngineOptions *eo[2],
+              bool reverse);
 
 void game_decode_state(const Game *g, str_t *result, str_t *reason);
 void game_export_pgn(const Game *g, int verbosity, str_t *out);
-void game_export_samples(const Game *g, FILE *out, bool bin);
+void game_export_samples(const Game *g, bool bin, char **vecOut);
@@ -0,0 +1,462 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "gzip.h"
+#include "util.h"
+#include "vec.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef USE_ZLIB
+    #include <zlib.h>
+#endif
+
+enum {
+    MEMBER_MAX = 1 << 26, // input bytes per member, so that the member size fits in 32 bits
+    HEADER_SIZE = 20,     // gzip header, including the 'CC' extra field
+};
+
+static uint32_t CrcTable[256];
+
+static __attribute__((constructor)) void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+        CrcTable[i] = c;
+    }
+}
+
+uint32_t gzip_crc32(uint32_t crc, const char *buf, size_t len) {
+    crc = ~crc;
+
+    for (size_t i = 0; i < len; i++)
+        crc = CrcTable[(crc ^ (uint8_t)buf[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+static void put_u32(char **vecOut, uint32_t u) {
+    for (int i = 0; i < 4; i++)
+        vec_push(*vecOut, (char)(u >> (8 * i)));
+}
+
+#ifdef USE_ZLIB
+
+// Raw deflate stream (no zlib or gzip wrapper), using zlib
+static void deflate_raw(const char *buf, size_t len, char **vecOut) {
+    z_stream z = {0};
+    DIE_IF(deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK);
+
+    const size_t start = vec_size(*vecOut), bound = deflateBound(&z, (uLong)len);
+    *vecOut = vec_do_grow(*vecOut, 1, bound);
+
+    z.next_in = (Bytef *)buf;
+    z.avail_in = (uInt)len;
+    z.next_out = (Bytef *)&(*vecOut)[start];
+    z.avail_out = (uInt)bound;
+
+    DIE_IF(deflate(&z, Z_FINISH) != Z_STREAM_END);
+    vec_ptr(*vecOut)->size = start + z.total_out;
+    deflateEnd(&z);
+}
+
+#else
+
+// Self-contained deflate encoder (RFC 1951): LZ77 with hash chains, and dynamic Huffman blocks
+
+enum {
+    WINDOW = 1 << 15,       // LZ77 window size
+    HASH_BITS = 15,         // hash table size (log2)
+    MAX_CHAIN = 64,         // match candidates to examine per position
+    MIN_MATCH = 3,          //
+    MAX_MATCH = 258,        //
+    BLOCK_TOKENS = 1 << 16, // tokens per block
+    NB_LITLEN = 286,        // literal/length alphabet: 0..255 = literal, 256 = EOB, 257.. = length
+    NB_DIST = 30,           // distance alphabet
+    NB_CODELEN = 19,        // code length alphabet
+};
+
+static const uint16_t LengthBase[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11,  13,
+                                        15, 17, 19, 23,  27,  31,  35,  43,  51,  59,
+                                        67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                        2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DistBase[30] = {1,    2,    3,    4,     5,     7,    9,    13,
+                                      17,   25,   33,   49,    65,    97,   129,  193,
+                                      257,  385,  513,  769,   1025,  1537, 2049, 3073,
+                                      4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t CodeLenOrder[NB_CODELEN] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                 11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+typedef struct {
+    uint16_t len, dist; // match (dist > 0), or literal len (dist = 0)
+} Token;
+
+typedef struct {
+    char **vecOut;
+    uint64_t bits;
+    int count;
+} BitWriter;
+
+typedef struct {
+    uint32_t freq;
+    int symbol;
+} Leaf;
+
+typedef struct {
+    uint8_t symbol, extra; // code length symbol (0..18), and value of its extra bits
+} CodeLen;
+
+static void put_bits(BitWriter *bw, uint32_t value, int n) {
+    bw->bits |= (uint64_t)value << bw->count;
+    bw->count += n;
+
+    for (; bw->count >= 8; bw->count -= 8, bw->bits >>= 8)
+        vec_push(*bw->vecOut, (char)(bw->bits & 0xff));
+}
+
+static int length_code(int len) {
+    int c = 28;
+
+    while (LengthBase[c] > len)
+        c--;
+
+    return c;
+}
+
+static int dist_code(int dist) {
+    int c = 29;
+
+    while (DistBase[c] > dist)
+        c--;
+
+    return c;
+}
+
+static int compare_leaves(const void *a, const void *b) {
+    const Leaf *la = a, *lb = b;
+    return la->freq != lb->freq ? (la->freq < lb->freq ? -1 : 1) : la->symbol - lb->symbol;
+}
+
+// Huffman code lengths for freq[0..n-1], limited to maxLength bits. At least two symbols are given
+// a code (even with zero frequency), so that the code is always complete.
+static void huffman_lengths(const uint32_t *freq, int n, int maxLength, uint8_t *lengths) {
+    Leaf leaves[NB_LITLEN];
+    uint32_t weight[2 * NB_LITLEN], scaled[NB_LITLEN];
+    int parent[2 * NB_LITLEN], depth[2 * NB_LITLEN];
+
+    memcpy(scaled, freq, (size_t)n * sizeof(*freq));
+
+    int used = 0;
+
+    for (int i = 0; i < n; i++)
+        used += scaled[i] > 0;
+
+    for (int i = 0; i < n && used < 2; i++)
+        if (!scaled[i]) {
+            scaled[i] = 1;
+            used++;
+        }
+
+    while (true) {
+        int m = 0;
+
+        for (int i = 0; i < n; i++)
+            if (scaled[i])
+                leaves[m++] = (Leaf){.freq = scaled[i], .symbol = i};
+
+        qsort(leaves, (size_t)m, sizeof(Leaf), compare_leaves);
+
+        for (int i = 0; i < m; i++)
+            weight[i] = leaves[i].freq;
+
+        // Two queues: leaves[] in order, and internal nodes, which are created in order
+        for (int next = m, leaf = 0, node = m; next < 2 * m - 1; next++) {
+            int child[2];
+
+            for (int k = 0; k < 2; k++)
+                child[k] = leaf < m && (node >= next || weight[leaf] <= weight[node]) ? leaf++
+                                                                                       : node++;
+
+            weight[next] = weight[child[0]] + weight[child[1]];
+            parent[child[0]] = parent[child[1]] = next;
+        }
+
+        depth[2 * m - 2] = 0;
+        int maxDepth = 0;
+
+        for (int i = 2 * m - 3; i >= 0; i--) {
+            depth[i] = depth[parent[i]] + 1;
+            maxDepth = max(maxDepth, depth[i]);
+        }
+
+        if (maxDepth <= maxLength) {
+            memset(lengths, 0, (size_t)n);
+
+            for (int i = 0; i < m; i++)
+                lengths[leaves[i].symbol] = (uint8_t)depth[i];
+
+            return;
+        }
+
+        // Too deep: flatten the distribution, and try again
+        for (int i = 0; i < n; i++)
+            if (scaled[i])
+                scaled[i] = (scaled[i] >> 1) | 1;
+    }
+}
+
+// Canonical Huffman codes, bit reversed (Huffman codes are written MSB first)
+static void huffman_codes(const uint8_t *lengths, int n, uint16_t *codes) {
+    int count[16] = {0}, next[16] = {0};
+
+    for (int i = 0; i < n; i++)
+        count[lengths[i]]++;
+
+    count[0] = 0;
+
+    for (int bits = 1, code = 0; bits < 16; bits++) {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+
+    for (int i = 0; i < n; i++)
+        if (lengths[i]) {
+            const int code = next[lengths[i]]++;
+            uint16_t reversed = 0;
+
+            for (int b = 0; b < lengths[i]; b++)
+                reversed |= (uint16_t)(((code >> b) & 1) << (lengths[i] - 1 - b));
+
+            codes[i] = reversed;
+        }
+}
+
+// Write tokens[0..n-1] as a dynamic Huffman block
+static void write_block(BitWriter *bw, const Token *tokens, size_t n, bool last) {
+    uint32_t litFreq[NB_LITLEN] = {0}, distFreq[NB_DIST] = {0}, clFreq[NB_CODELEN] = {0};
+    uint8_t lengths[NB_LITLEN + NB_DIST] = {0}, clLengths[NB_CODELEN] = {0};
+    uint16_t litCodes[NB_LITLEN] = {0}, distCodes[NB_DIST] = {0}, clCodes[NB_CODELEN] = {0};
+
+    for (size_t i = 0; i < n; i++)
+        if (tokens[i].dist) {
+            litFreq[257 + length_code(tokens[i].len)]++;
+            distFreq[dist_code(tokens[i].dist)]++;
+        } else
+            litFreq[tokens[i].len]++;
+
+    litFreq[256] = 1; // end of block
+
+    huffman_lengths(litFreq, NB_LITLEN, 15, lengths);
+    huffman_lengths(distFreq, NB_DIST, 15, &lengths[NB_LITLEN]);
+    huffman_codes(lengths, NB_LITLEN, litCodes);
+    huffman_codes(&lengths[NB_LITLEN], NB_DIST, distCodes);
+
+    int nbLit = NB_LITLEN, nbDist = NB_DIST;
+
+    while (nbLit > 257 && !lengths[nbLit - 1])
+        nbLit--;
+
+    while (nbDist > 1 && !lengths[NB_LITLEN + nbDist - 1])
+        nbDist--;
+
+    // Code lengths of both alphabets, as one sequence, run length encoded with symbols 16..18
+    uint8_t seq[NB_LITLEN + NB_DIST];
+    memcpy(seq, lengths, (size_t)nbLit);
+    memcpy(&seq[nbLit], &lengths[NB_LITLEN], (size_t)nbDist);
+    const int nbSeq = nbLit + nbDist;
+
+    CodeLen rle[NB_LITLEN + NB_DIST];
+    int nbRle = 0;
+
+    for (int i = 0, run; i < nbSeq; i += run) {
+        for (run = 1; i + run < nbSeq && seq[i + run] == seq[i]; run++)
+            ;
+
+        if (!seq[i] && run >= 11) {
+            run = min(run, 138);
+            rle[nbRle++] = (CodeLen){18, (uint8_t)(run - 11)};
+        } else if (!seq[i] && run >= 3)
+            rle[nbRle++] = (CodeLen){17, (uint8_t)(run - 3)};
+        else if (seq[i] && run >= 4) {
+            run = min(run, 7);
+            rle[nbRle++] = (CodeLen){seq[i], 0};
+            rle[nbRle++] = (CodeLen){16, (uint8_t)(run - 4)};
+        } else {
+            run = 1;
+            rle[nbRle++] = (CodeLen){seq[i], 0};
+        }
+    }
+
+    for (int i = 0; i < nbRle; i++)
+        clFreq[rle[i].symbol]++;
+
+    huffman_lengths(clFreq, NB_CODELEN, 7, clLengths);
+    huffman_codes(clLengths, NB_CODELEN, clCodes);
+
+    int nbCodeLen = NB_CODELEN;
+
+    while (nbCodeLen > 4 && !clLengths[CodeLenOrder[nbCodeLen - 1]])
+        nbCodeLen--;
+
+    // Block header
+    put_bits(bw, last, 1);
+    put_bits(bw, 2, 2);
+    put_bits(bw, (uint32_t)(nbLit - 257), 5);
+    put_bits(bw, (uint32_t)(nbDist - 1), 5);
+    put_bits(bw, (uint32_t)(nbCodeLen - 4), 4);
+
+    for (int i = 0; i < nbCodeLen; i++)
+        put_bits(bw, clLengths[CodeLenOrder[i]], 3);
+
+    static const int rleExtra[3] = {2, 3, 7}; // extra bits of symbols 16, 17, 18
+
+    for (int i = 0; i < nbRle; i++) {
+        const int s = rle[i].symbol;
+        put_bits(bw, clCodes[s], clLengths[s]);
+
+        if (s >= 16)
+            put_bits(bw, rle[i].extra, rleExtra[s - 16]);
+    }
+
+    // Block data
+    for (size_t i = 0; i < n; i++)
+        if (tokens[i].dist) {
+            const int lc = length_code(tokens[i].len), dc = dist_code(tokens[i].dist);
+            put_bits(bw, litCodes[257 + lc], lengths[257 + lc]);
+            put_bits(bw, (uint32_t)(tokens[i].len - LengthBase[lc]), LengthExtra[lc]);
+            put_bits(bw, distCodes[dc], lengths[NB_LITLEN + dc]);
+            put_bits(bw, (uint32_t)(tokens[i].dist - DistBase[dc]), DistExtra[dc]);
+        } else
+            put_bits(bw, litCodes[tokens[i].len], lengths[tokens[i].len]);
+
+    put_bits(bw, litCodes[256], lengths[256]);
+}
+
+static uint32_t hash3(const char *p) {
+    const uint32_t x = (uint32_t)(uint8_t)p[0] | (uint32_t)(uint8_t)p[1] << 8 |
+                       (uint32_t)(uint8_t)p[2] << 16;
+    return (x * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void deflate_raw(const char *buf, size_t len, char **vecOut) {
+    BitWriter bw = {.vecOut = vecOut};
+    Token *vecTokens = vec_init_reserve(BLOCK_TOKENS, Token);
+    int32_t *head = malloc((1 << HASH_BITS) * sizeof(int32_t));
+    int32_t *prev = malloc(WINDOW * sizeof(int32_t));
+
+    for (size_t i = 0; i < 1 << HASH_BITS; i++)
+        head[i] = -1;
+
+    for (size_t i = 0; i < len;) {
+        int bestLen = 0, bestDist = 0;
+
+        if (i + MIN_MATCH <= len) {
+            const uint32_t h = hash3(&buf[i]);
+            const int maxLen = (int)min(len - i, (size_t)MAX_MATCH);
+            int32_t candidate = head[h];
+
+            for (int chain = 0; chain < MAX_CHAIN && candidate >= 0 &&
+                                (int32_t)i - candidate <= WINDOW;
+                 chain++, candidate = prev[candidate & (WINDOW - 1)]) {
+                const char *a = &buf[candidate], *b = &buf[i];
+
+                if (a[bestLen] != b[bestLen])
+                    continue;
+
+                int l = 0;
+
+                while (l < maxLen && a[l] == b[l])
+                    l++;
+
+                if (l > bestLen) {
+                    bestLen = l;
+                    bestDist = (int)i - candidate;
+
+                    if (l == maxLen)
+                        break;
+                }
+            }
+        }
+
+        const size_t step = bestLen >= MIN_MATCH ? (size_t)bestLen : 1;
+
+        if (bestLen >= MIN_MATCH)
+            vec_push(vecTokens, ((Token){.len = (uint16_t)bestLen, .dist = (uint16_t)bestDist}));
+        else
+            vec_push(vecTokens, ((Token){.len = (uint8_t)buf[i]}));
+
+        // Insert the positions covered by this token in the hash chains
+        for (size_t j = i; j < i + step && j + MIN_MATCH <= len; j++) {
+            const uint32_t h = hash3(&buf[j]);
+            prev[j & (WINDOW - 1)] = head[h];
+            head[h] = (int32_t)j;
+        }
+
+        i += step;
+
+        if (vec_size(vecTokens) == BLOCK_TOKENS && i < len) {
+            write_block(&bw, vecTokens, vec_size(vecTokens), false);
+            vec_clear(vecTokens);
+        }
+    }
+
+    write_block(&bw, vecTokens, vec_size(vecTokens), true);
+
+    // Flush the last (partial) byte
+    if (bw.count)
+        put_bits(&bw, 0, 8 - bw.count);
+
+    free(prev);
+    free(head);
+    vec_destroy(vecTokens);
+}
+
+#endif
+
+void gzip_member(const char *buf, size_t len, char **vecOut) {
+    do {
+        const size_t n = min(len, (size_t)MEMBER_MAX), start = vec_size(*vecOut);
+
+        // Header: magic, deflate, FEXTRA flag, no mtime, no extra flags, unknown OS. Extra field
+        // 'CC' holds the member size, written when known.
+        static const char header[16] = {0x1f, (char)0x8b, 8, 4, 0, 0, 0, 0, 0, (char)255, 8, 0,
+                                        'C',  'C',        4, 0};
+        vec_push_n(*vecOut, header, sizeof(header));
+        put_u32(vecOut, 0);
+
+        deflate_raw(buf, n, vecOut);
+        put_u32(vecOut, gzip_crc32(0, buf, n));
+        put_u32(vecOut, (uint32_t)n);
+
+        const uint32_t size = (uint32_t)(vec_size(*vecOut) - start);
+
+        for (int i = 0; i < 4; i++)
+            (*vecOut)[start + HEADER_SIZE - 4 + (size_t)i] = (char)(size >> (8 * i));
+
+        buf += n;
+        len -= n;
+    } while (len);
+}
+
+bool gzip_file_name(const char *fileName) {
+    const size_t len = strlen(fileName);
+    return len > 3 && !strcmp(&fileName[len - 3], ".gz");
+}
@@ -0,0 +1,29 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Append gzip members (RFC 1952) compressing buf[0..len-1] to *vecOut. Members are independent, and
+// their header has an extra field 'CC', holding the size of the member (uint32_t little endian), so
+// that a reader can find member boundaries without decompressing, and decompress them in parallel.
+void gzip_member(const char *buf, size_t len, char **vecOut);
+
+// CRC-32 (as used by gzip) of buf[0..len-1], continuing from crc (0 to start)
+uint32_t gzip_crc32(uint32_t crc, const char *buf, size_t len);
+
+// Output files whose name ends with .gz are compressed
+bool gzip_file_name(const char *fileName);
@@ -0,0 +1,270 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef __linux__
+    #define _GNU_SOURCE
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <limits.h>
+    #include <sys/epoll.h>
+    #include <sys/mman.h>
+    #include <ucontext.h>
+    #include <unistd.h>
+#endif
+
+#include "ioloop.h"
+#include "util.h"
+#include "vec.h"
+
+#ifdef __linux__
+
+enum { STACK_SIZE = 256 * 1024, MAX_EVENTS = 64 };
+
+// Coroutine running a worker. Tasks never migrate from one loop (ie. thread) to another, which
+// keeps _Thread_local variables valid across context switches.
+struct IOTask {
+    ucontext_t ctx;
+    IOLoop *loop;
+    Worker *w;
+    void *(*start)(void *);
+    void *stack;
+    uint64_t waitId; // incremented by each io_wait(), to recognize stale timers
+    bool waiting, timedOut, done;
+};
+
+typedef struct IOTask IOTask;
+
+// Pending io_wait() time limit. Timers are not removed when their wait completes early: they become
+// stale (waitId mismatch), and are simply discarded when they reach the top of the heap.
+struct IOTimer {
+    int64_t timeLimit;
+    uint64_t waitId;
+    IOTask *task;
+};
+
+typedef struct IOTimer IOTimer;
+
+// Scheduler context of the current thread, and the task it is running
+static _Thread_local ucontext_t schedulerCtx;
+static _Thread_local IOTask *running;
+
+static void io_task_entry(void) {
+    running->start(running->w);
+    running->done = true;
+    // returning switches back to schedulerCtx, via uc_link
+}
+
+// Binary min-heap of timers, ordered by timeLimit
+static void io_timer_push(IOLoop *loop, IOTimer timer) {
+    vec_push(loop->vecTimers, timer);
+    size_t i = vec_size(loop->vecTimers) - 1;
+
+    for (size_t parent; i && loop->vecTimers[parent = (i - 1) / 2].timeLimit > timer.timeLimit;
+         i = parent)
+        loop->vecTimers[i] = loop->vecTimers[parent];
+
+    loop->vecTimers[i] = timer;
+}
+
+static void io_timer_pop(IOLoop *loop) {
+    const size_t size = --vec_ptr(loop->vecTimers)->size;
+    const IOTimer last = loop->vecTimers[size];
+    size_t i = 0;
+
+    for (size_t child; (child = 2 * i + 1) < size; i = child) {
+        if (child + 1 < size &&
+            loop->vecTimers[child + 1].timeLimit < loop->vecTimers[child].timeLimit)
+            child++;
+
+        if (last.timeLimit <= loop->vecTimers[child].timeLimit)
+            break;
+
+        loop->vecTimers[i] = loop->vecTimers[child];
+    }
+
+    if (size)
+        loop->vecTimers[i] = last;
+}
+
+// Wake up task t, if it is still waiting
+static void io_wake(IOTask *t, bool timedOut, IOTask ***vecRunnable) {
+    if (t->waiting) {
+        t->waiting = false;
+        t->timedOut = timedOut;
+        vec_push(*vecRunnable, t);
+    }
+}
+
+IOLoop io_loop_init(void) {
+    IOLoop loop = {.vecTasks = vec_init(IOTask *), .vecTimers = vec_init(IOTimer)};
+    DIE_IF((loop.epfd = epoll_create1(EPOLL_CLOEXEC)) < 0);
+    return loop;
+}
+
+void io_loop_destroy(IOLoop *loop) {
+    // Finished tasks are freed by io_loop_run(). Unfinished ones can only exist if we are exiting
+    // from within a coroutine (eg. DIE()), in which case its stack must not be released under our
+    // feet.
+    vec_destroy(loop->vecTasks);
+    vec_destroy(loop->vecTimers);
+    DIE_IF(close(loop->epfd) < 0);
+}
+
+void io_loop_add(IOLoop *loop, Worker *w, void *(*start)(void *)) {
+    IOTask *t = calloc(1, sizeof(IOTask));
+    *t = (IOTask){.loop = loop, .w = w, .start = start};
+
+    // Allocate the stack with mmap(), so that memory is only committed as it is used
+    t->stack = mmap(NULL, STACK_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+    DIE_IF(t->stack == MAP_FAILED);
+
+    w->task = t;
+    vec_push(loop->vecTasks, t);
+}
+
+void *io_loop_run(void *arg) {
+    IOLoop *loop = arg;
+
+    // All tasks start runnable. Then, each one is resumed when its file descriptor is readable, or
+    // its time limit is reached. Contexts are made here, because uc_link must point to this
+    // thread's scheduler context.
+    IOTask **vecRunnable = vec_init(IOTask *);
+
+    for (size_t i = 0; i < vec_size(loop->vecTasks); i++) {
+        IOTask *t = loop->vecTasks[i];
+        DIE_IF(getcontext(&t->ctx) < 0);
+        t->ctx.uc_stack = (stack_t){.ss_sp = t->stack, .ss_size = STACK_SIZE};
+        t->ctx.uc_link = &schedulerCtx;
+        makecontext(&t->ctx, io_task_entry, 0);
+        vec_push(vecRunnable, t);
+    }
+
+    size_t alive = vec_size(loop->vecTasks);
+    struct epoll_event events[MAX_EVENTS];
+
+    while (alive) {
+        for (size_t i = 0; i < vec_size(vecRunnable); i++) {
+            running = vecRunnable[i];
+            threadId = running->w->id;
+            DIE_IF(swapcontext(&schedulerCtx, &running->ctx) < 0);
+
+            if (running->done) {
+                // Release the stack now, but keep the task itself: stale timers may point to it
+                running->w->task = NULL;
+                DIE_IF(munmap(running->stack, STACK_SIZE) < 0);
+                alive--;
+            }
+        }
+
+        vec_clear(vecRunnable);
+        running = NULL;
+        threadId = 0;
+
+        if (!alive)
+            break;
+
+        // Fire expired timers, and compute the epoll_wait() timeout from the earliest remaining one
+        int timeout = -1;
+
+        while (vec_size(loop->vecTimers)) {
+            const IOTimer top = loop->vecTimers[0];
+
+            if (top.waitId == top.task->waitId && top.task->waiting) {
+                const int64_t remaining = top.timeLimit - system_msec();
+
+                if (remaining > 0) {
+                    timeout = (int)min(remaining, (int64_t)INT_MAX);
+                    break;
+                }
+
+                io_wake(top.task, true, &vecRunnable);
+            }
+
+            io_timer_pop(loop);
+        }
+
+        if (vec_size(vecRunnable))
+            timeout = 0; // poll only
+
+        int n;
+
+        while ((n = epoll_wait(loop->epfd, events, MAX_EVENTS, timeout)) < 0)
+            DIE_IF(errno != EINTR);
+
+        for (int i = 0; i < n; i++)
+            io_wake(events[i].data.ptr, false, &vecRunnable);
+    }
+
+    for (size_t i = 0; i < vec_size(loop->vecTasks); i++)
+        free(loop->vecTasks[i]);
+
+    vec_clear(loop->vecTasks);
+    vec_destroy(vecRunnable);
+    return NULL;
+}
+
+void io_nonblocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL);
+    DIE_IF(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0);
+}
+
+bool io_wait(Worker *w, int fd, int64_t timeLimit) {
+    IOTask *t = w->task;
+    assert(t && t == running);
+
+    // Arm a one shot notification for fd, and yield to the scheduler until it fires. Note that
+    // closing fd automatically removes it from the epoll set, hence the ENOENT case.
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = t};
+
+    if (epoll_ctl(t->loop->epfd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        DIE_IF(errno != ENOENT);
+        DIE_IF(epoll_ctl(t->loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0);
+    }
+
+    t->waitId++;
+    t->waiting = true;
+
+    if (timeLimit < INT64_MAX / 2) // otherwise, no time limit
+        io_timer_push(t->loop, (IOTimer){.timeLimit = timeLimit, .waitId = t->waitId, .task = t});
+
+    DIE_IF(swapcontext(&t->ctx, &schedulerCtx) < 0);
+
+    // Timed out: disarm fd, so that it does not wake us up later, while waiting for something else
+    if (t->timedOut)
+        DIE_IF(epoll_ctl(t->loop->epfd, EPOLL_CTL_DEL, fd, NULL) < 0);
+
+    return !t->timedOut;
+}
+
+#else
+
+IOLoop io_loop_init(void) { DIE("event driven mode (-iothreads) is only supported on Linux\n"); }
+
+void io_loop_destroy(IOLoop *loop) { (void)loop; }
+
+void io_loop_add(IOLoop *loop, Worker *w, void *(*start)(void *)) {
+    (void)loop, (void)w, (void)start;
+}
+
+void *io_loop_run(void *loop) { return loop; }
+
+void io_nonblocking(int fd) { (void)fd; }
+
+bool io_wait(Worker *w, int fd, int64_t timeLimit) {
+    (void)w, (void)fd, (void)timeLimit;
+    return false;
+}
+
+#endif
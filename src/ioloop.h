@@ -0,0 +1,40 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "workers.h"
+
+// Event loop: runs many workers as coroutines on a single thread, suspending them while they wait
+// for engine output, instead of dedicating a blocking thread to each worker (Linux only).
+typedef struct {
+    struct IOTask **vecTasks;
+    struct IOTimer *vecTimers;
+    int epfd;
+} IOLoop;
+
+IOLoop io_loop_init(void);
+void io_loop_destroy(IOLoop *loop);
+
+// Schedule start(w) to run as a coroutine of 'loop'. Must be called before io_loop_run().
+void io_loop_add(IOLoop *loop, Worker *w, void *(*start)(void *));
+
+// Thread entry point: runs the event loop until all its coroutines have returned.
+void *io_loop_run(void *loop);
+
+// Prepare fd for use in event driven mode (nonblocking).
+void io_nonblocking(int fd);
+
+// Suspend the calling coroutine until fd becomes readable (returns true), or timeLimit is reached
+// (returns false).
+bool io_wait(Worker *w, int fd, int64_t timeLimit);
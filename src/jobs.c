@@ -13,24 +13,35 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #include "jobs.h"
+#include "util.h"
 #include "vec.h"
 #include "workers.h"
 #include <stdio.h>
 
-static void job_queue_init_pair(int games, int e1, int e2, int pair, int *added, int round,
-                                Job **jobs) {
-    for (int g = 0; g < games; g++) {
-        const Job j = {
-            .ei = {e1, e2}, .pair = pair, .round = round, .game = (*added)++, .reverse = g % 2};
-        vec_push(*jobs, j);
-    }
-}
+// Outcome of the first completed game of a game pair (idx/2), waiting for the other one
+struct HalfPair {
+    size_t idx;
+    int outcome;
+};
+
+// Void job, and the number of times it was played
+struct Replay {
+    size_t idx;
+    int count;
+};
 
-JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet) {
+JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet, bool pentanomial) {
     assert(engines >= 2 && rounds >= 1 && games >= 1);
 
-    JobQueue jq = {
-        .vecJobs = vec_init(Job), .vecResults = vec_init(Result), .vecNames = vec_init(str_t)};
+    JobQueue jq = {.vecResults = vec_init(Result),
+                   .vecNames = vec_init(str_t),
+                   .vecInflight = vec_init(size_t),
+                   .vecRequeued = vec_init(size_t),
+                   .vecHalfPairs = vec_init(struct HalfPair),
+                   .vecReplays = vec_init(struct Replay),
+                   .ratings = ratings_init(engines),
+                   .games = games,
+                   .pentanomial = pentanomial};
     pthread_mutex_init(&jq.mtx, NULL);
 
     // Prepare engine names: blank for now, will be discovered at run time (concurrently)
@@ -43,13 +54,6 @@ JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet) {
             const Result r = {.ei = {0, e2}};
             vec_push(jq.vecResults, r);
         }
-
-        for (int r = 0; r < rounds; r++) {
-            int added = 0; // number of games already added to the current round
-
-            for (int e2 = 1; e2 < engines; e2++)
-                job_queue_init_pair(games, 0, e2, e2 - 1, &added, r, &jq.vecJobs);
-        }
     } else {
         // Round robin: N(N-1)/2 pairs (e1, e2) with e1 < e2
         for (int e1 = 0; e1 < engines - 1; e1++)
@@ -57,67 +61,260 @@ JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet) {
                 const Result r = {.ei = {e1, e2}};
                 vec_push(jq.vecResults, r);
             }
+    }
 
-        for (int r = 0; r < rounds; r++) {
-            int pair = 0;  // enumerate pairs in order
-            int added = 0; // number of games already added to the current round
+    // Each round plays all pairs in order, and each pair plays 'games' games
+    jq.count = (size_t)rounds * vec_size(jq.vecResults) * (size_t)games;
+    jq.vecTaken = vec_init_reserve(vec_size(jq.vecResults), size_t);
 
-            for (int e1 = 0; e1 < engines - 1; e1++)
-                for (int e2 = e1 + 1; e2 < engines; e2++)
-                    job_queue_init_pair(games, e1, e2, pair++, &added, r, &jq.vecJobs);
-        }
-    }
+    for (size_t i = 0; i < vec_size(jq.vecResults); i++)
+        vec_push(jq.vecTaken, 0);
 
     return jq;
 }
 
 void job_queue_destroy(JobQueue *jq) {
     vec_destroy(jq->vecResults);
-    vec_destroy(jq->vecJobs);
+    vec_destroy(jq->vecTaken);
+    vec_destroy(jq->vecInflight);
+    vec_destroy(jq->vecRequeued);
+    vec_destroy(jq->vecHalfPairs);
+    vec_destroy(jq->vecReplays);
     vec_destroy_rec(jq->vecNames, str_destroy);
+    ratings_destroy(&jq->ratings);
     pthread_mutex_destroy(&jq->mtx);
 }
 
-bool job_queue_pop(JobQueue *jq, Job *j, size_t *idx, size_t *count) {
+// Jobs are laid out by round, then pair, then game. Map job index <-> (pair, ordinal), where
+// ordinal is the rank of the job among those of the same pair.
+static size_t job_queue_ordinal(const JobQueue *jq, size_t idx, int *pair) {
+    const size_t games = (size_t)jq->games, pairs = vec_size(jq->vecResults);
+    *pair = (int)(idx / games % pairs);
+    return idx / (pairs * games) * games + idx % games;
+}
+
+static size_t job_queue_index(const JobQueue *jq, int pair, size_t ordinal) {
+    const size_t games = (size_t)jq->games, pairs = vec_size(jq->vecResults);
+    return ordinal / games * pairs * games + (size_t)pair * games + ordinal % games;
+}
+
+static Job job_queue_decode(const JobQueue *jq, size_t idx) {
+    const size_t games = (size_t)jq->games, pairs = vec_size(jq->vecResults);
+    const size_t g = idx % games, pair = idx / games % pairs;
+
+    return (Job){.ei = {jq->vecResults[pair].ei[0], jq->vecResults[pair].ei[1]},
+                 .pair = (int)pair,
+                 .round = (int)(idx / (pairs * games)),
+                 .game = (int)(idx % (pairs * games)),
+                 .reverse = g % 2};
+}
+
+// Advance the scan index to the first job not taken yet, and return it
+static size_t job_queue_scan(JobQueue *jq) {
+    int pair = 0;
+
+    while (jq->idx < jq->count &&
+           job_queue_ordinal(jq, jq->idx, &pair) < jq->vecTaken[pair])
+        jq->idx++;
+
+    return jq->idx;
+}
+
+bool job_queue_pop(JobQueue *jq, int pair, Job *j, size_t *idx, size_t *count) {
     pthread_mutex_lock(&jq->mtx);
-    const bool ok = jq->idx < vec_size(jq->vecJobs);
+    bool ok = false;
+
+    // Requeued jobs are played even after a stop: output files are written in job order, so every
+    // job taken must be completed.
+    if (vec_size(jq->vecRequeued)) {
+        *idx = vec_pop(jq->vecRequeued);
+        ok = true;
+    } else if (!jq->stopped) {
+        // Affinity is limited to the round of the first job left: output files are written in job
+        // order, so games played ahead must be held back in memory until then.
+        const size_t first = job_queue_scan(jq), games = (size_t)jq->games;
+
+        if (pair >= 0 && first < jq->count &&
+            jq->vecTaken[pair] / games == first / (games * vec_size(jq->vecResults))) {
+            *idx = job_queue_index(jq, pair, jq->vecTaken[pair]++);
+            ok = true;
+        } else if ((*idx = first) < jq->count) {
+            job_queue_ordinal(jq, *idx, &pair);
+            jq->vecTaken[pair]++;
+            ok = true;
+        }
+    }
 
     if (ok) {
-        *j = jq->vecJobs[jq->idx];
-        *idx = jq->idx++;
-        *count = vec_size(jq->vecJobs);
+        *j = job_queue_decode(jq, *idx);
+        *count = jq->count;
+        vec_push(jq->vecInflight, *idx);
     }
 
     pthread_mutex_unlock(&jq->mtx);
     return ok;
 }
 
-// Add game outcome, and return updated totals
-void job_queue_add_result(JobQueue *jq, int pair, int outcome, int count[3]) {
+// Complete the game pair, or wait for the other game. Note that outcomes are counted in half points
+// (RESULT_LOSS=0, RESULT_DRAW=1, RESULT_WIN=2).
+static void job_queue_add_half_pair(JobQueue *jq, size_t idx, int pair, int outcome) {
+    for (size_t i = 0; i < vec_size(jq->vecHalfPairs); i++)
+        if (jq->vecHalfPairs[i].idx == idx / 2) {
+            jq->vecResults[pair].penta[jq->vecHalfPairs[i].outcome + outcome]++;
+            jq->vecHalfPairs[i] = vec_pop(jq->vecHalfPairs);
+            return;
+        }
+
+    vec_push(jq->vecHalfPairs, ((struct HalfPair){.idx = idx / 2, .outcome = outcome}));
+}
+
+Result job_queue_add_result(JobQueue *jq, size_t idx, int pair, int outcome) {
     pthread_mutex_lock(&jq->mtx);
-    jq->vecResults[pair].count[outcome]++;
-    jq->completed++;
 
-    for (size_t i = 0; i < 3; i++)
-        count[i] = jq->vecResults[pair].count[i];
+    for (size_t i = 0; i < vec_size(jq->vecInflight); i++)
+        if (jq->vecInflight[i] == idx) {
+            jq->vecInflight[i] = vec_pop(jq->vecInflight);
+            break;
+        }
+
+    // Void game: play it again, unless it keeps failing (eg. an engine crashes on startup)
+    if (outcome == NB_RESULT) {
+        size_t i = 0;
+
+        while (i < vec_size(jq->vecReplays) && jq->vecReplays[i].idx != idx)
+            i++;
+
+        if (i == vec_size(jq->vecReplays))
+            vec_push(jq->vecReplays, ((struct Replay){.idx = idx}));
+
+        if (++jq->vecReplays[i].count > MAX_REPLAYS) {
+            const int *ei = jq->vecResults[pair].ei;
+            pthread_mutex_unlock(&jq->mtx);
+            DIE("game %zu (%s vs %s) could not start, %d times in a row\n", idx + 1,
+                jq->vecNames[ei[0]].buf, jq->vecNames[ei[1]].buf, MAX_REPLAYS + 1);
+        }
+
+        vec_push(jq->vecRequeued, idx);
+    } else {
+        jq->vecResults[pair].count[outcome]++;
+        jq->completed++;
+
+        ratings_add(&jq->ratings, jq->vecResults[pair].ei[0], jq->vecResults[pair].ei[1],
+                    0.5 * outcome, 1);
+
+        // Ratings are only printed beyond a single pair of engines
+        if (vec_size(jq->vecNames) > 2)
+            ratings_update(&jq->ratings);
 
+        if (jq->pentanomial)
+            job_queue_add_half_pair(jq, idx, pair, outcome);
+    }
+
+    const Result r = jq->vecResults[pair];
     pthread_mutex_unlock(&jq->mtx);
+    return r;
 }
 
-bool job_queue_done(JobQueue *jq) {
+void job_queue_stop(JobQueue *jq) {
     pthread_mutex_lock(&jq->mtx);
-    assert(jq->idx <= vec_size(jq->vecJobs));
-    const bool done = jq->idx == vec_size(jq->vecJobs);
+    jq->stopped = true;
     pthread_mutex_unlock(&jq->mtx);
-    return done;
 }
 
-void job_queue_stop(JobQueue *jq) {
+void job_queue_save(JobQueue *jq, FILE *out) {
     pthread_mutex_lock(&jq->mtx);
-    jq->idx = vec_size(jq->vecJobs);
+
+    DIE_IF(fprintf(out, "jobs %zu %zu %zu %d\n", jq->count, vec_size(jq->vecResults), jq->completed,
+                   jq->stopped) < 0);
+
+    for (size_t i = 0; i < vec_size(jq->vecResults); i++) {
+        const Result *r = &jq->vecResults[i];
+        DIE_IF(fprintf(out, "pair %zu %d %d %d %d %d %d %d %d\n", jq->vecTaken[i], r->count[0],
+                       r->count[1], r->count[2], r->penta[0], r->penta[1], r->penta[2],
+                       r->penta[3], r->penta[4]) < 0);
+    }
+
+    DIE_IF(fprintf(out, "halfpairs %zu", vec_size(jq->vecHalfPairs)) < 0);
+
+    for (size_t i = 0; i < vec_size(jq->vecHalfPairs); i++)
+        DIE_IF(fprintf(out, " %zu %d", jq->vecHalfPairs[i].idx, jq->vecHalfPairs[i].outcome) < 0);
+
+    DIE_IF(fputc('\n', out) < 0);
+
+    // Jobs in flight will be played again on resume. If we are saving a checkpoint taken on resume
+    // (before they are popped again), they are still requeued.
+    DIE_IF(fprintf(out, "inflight %zu",
+                   vec_size(jq->vecInflight) + vec_size(jq->vecRequeued)) < 0);
+
+    for (size_t i = 0; i < vec_size(jq->vecInflight); i++)
+        DIE_IF(fprintf(out, " %zu", jq->vecInflight[i]) < 0);
+
+    for (size_t i = 0; i < vec_size(jq->vecRequeued); i++)
+        DIE_IF(fprintf(out, " %zu", jq->vecRequeued[i]) < 0);
+
+    DIE_IF(fputc('\n', out) < 0);
     pthread_mutex_unlock(&jq->mtx);
 }
 
+void job_queue_load(JobQueue *jq, FILE *in) {
+    size_t count = 0, pairs = 0, inflight = 0;
+    int stopped = 0;
+
+    if (fscanf(in, " jobs %zu %zu %zu %d", &count, &pairs, &jq->completed, &stopped) != 4 ||
+        count != jq->count || pairs != vec_size(jq->vecResults))
+        DIE("checkpoint does not match this tournament\n");
+
+    jq->stopped = stopped;
+
+    for (size_t i = 0; i < pairs; i++) {
+        Result *r = &jq->vecResults[i];
+
+        if (fscanf(in, " pair %zu %d %d %d %d %d %d %d %d", &jq->vecTaken[i], &r->count[0],
+                   &r->count[1], &r->count[2], &r->penta[0], &r->penta[1], &r->penta[2],
+                   &r->penta[3], &r->penta[4]) != 9)
+            DIE("invalid checkpoint\n");
+
+        ratings_add(&jq->ratings, r->ei[0], r->ei[1],
+                    r->count[RESULT_WIN] + 0.5 * r->count[RESULT_DRAW],
+                    r->count[RESULT_WIN] + r->count[RESULT_LOSS] + r->count[RESULT_DRAW]);
+    }
+
+    ratings_solve(&jq->ratings);
+
+    size_t halfPairs = 0;
+
+    if (fscanf(in, " halfpairs %zu", &halfPairs) != 1)
+        DIE("invalid checkpoint\n");
+
+    for (size_t i = 0; i < halfPairs; i++) {
+        struct HalfPair hp = {0};
+
+        if (fscanf(in, " %zu %d", &hp.idx, &hp.outcome) != 2 || hp.outcome < 0 ||
+            hp.outcome >= NB_RESULT)
+            DIE("invalid checkpoint\n");
+
+        vec_push(jq->vecHalfPairs, hp);
+    }
+
+    if (fscanf(in, " inflight %zu", &inflight) != 1)
+        DIE("invalid checkpoint\n");
+
+    for (size_t i = 0; i < inflight; i++) {
+        size_t idx = 0;
+
+        if (fscanf(in, " %zu", &idx) != 1 || idx >= jq->count)
+            DIE("invalid checkpoint\n");
+
+        vec_push(jq->vecRequeued, idx);
+    }
+
+    // Replay in ascending order (vec_pop() takes the last one)
+    for (size_t i = 0; i < inflight; i++)
+        for (size_t j = i + 1; j < inflight; j++)
+            if (jq->vecRequeued[j] > jq->vecRequeued[i])
+                swap(jq->vecRequeued[i], jq->vecRequeued[j]);
+}
+
 void job_queue_set_name(JobQueue *jq, int ei, const char *name) {
     pthread_mutex_lock(&jq->mtx);
 
@@ -146,6 +343,12 @@ void job_queue_print_results(JobQueue *jq, size_t frequency) {
             }
         }
 
+        // Rating table, only useful beyond a single pair of engines
+        if (vec_size(jq->vecNames) > 2) {
+            ratings_solve(&jq->ratings);
+            ratings_print(&jq->ratings, jq->vecNames, &out);
+        }
+
         fputs(out.buf, stdout);
     }
 
@@ -13,14 +13,19 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include "rating.h"
 #include "str.h"
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 // Result for each pair (e1, e2); e1 < e2. Stores count of game outcomes from e1's point of view.
+// Games 2k and 2k+1 (same opening with -repeat) also form a game pair, whose score (0, 1/2, 1, 3/2
+// or 2 points) is counted in penta[] (pentanomial model), when the job queue tracks game pairs.
 typedef struct {
     int ei[2];
     int count[3];
+    int penta[5];
 } Result;
 
 // Job: instruction to play a single game
@@ -30,23 +35,42 @@ typedef struct {
     bool reverse;    // if true, e1 plays second
 } Job;
 
-// Job Queue: consumed by workers to play tournament (thread safe)
+enum { MAX_REPLAYS = 3 }; // a void game is played again at most MAX_REPLAYS times
+
+// Job Queue: consumed by workers to play tournament (thread safe). Jobs are not stored, but decoded
+// from their index. The jobs of each pair are always taken in order, so that job taken status is
+// simply encoded by a per pair cursor.
 typedef struct {
     pthread_mutex_t mtx;
-    Job *vecJobs;
-    size_t idx;       // next job index
-    size_t completed; // number of jobs completed
+    size_t count;                  // total number of jobs
+    size_t *vecTaken;              // per pair: number of jobs taken so far
+    size_t *vecInflight;           // jobs taken, whose result is not known yet
+    size_t *vecRequeued;           // jobs to play again: void, or in flight at checkpoint
+    struct HalfPair *vecHalfPairs; // game pairs with only one game completed
+    struct Replay *vecReplays;     // void jobs, and how many times they were played
+    size_t idx;                    // scan index: all jobs before idx are taken
+    size_t completed;              // number of jobs completed
     str_t *vecNames;
     Result *vecResults;
+    Ratings ratings; // Elo ratings of all engines, updated after each game (if > 2 engines)
+    int games;
+    bool stopped, pentanomial; // pentanomial: track game pairs, for penta[] counts
 } JobQueue;
 
-JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet);
+JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet, bool pentanomial);
 void job_queue_destroy(JobQueue *jq);
 
-bool job_queue_pop(JobQueue *jq, Job *j, size_t *idx, size_t *count);
-void job_queue_add_result(JobQueue *jq, int pair, int outcome, int count[3]);
-bool job_queue_done(JobQueue *jq);
+// Pop a job, preferably for 'pair' (if >= 0 and it has jobs left in the current round), otherwise
+// the first job left
+bool job_queue_pop(JobQueue *jq, int pair, Job *j, size_t *idx, size_t *count);
+// Record the outcome of job 'idx' (NB_RESULT for a void game, which is requeued, or fatal after
+// MAX_REPLAYS replays), and return updated pair totals
+Result job_queue_add_result(JobQueue *jq, size_t idx, int pair, int outcome);
 void job_queue_stop(JobQueue *jq);
 
+// Save/load the state of the queue, for checkpoint and resume. Jobs in flight are requeued.
+void job_queue_save(JobQueue *jq, FILE *out);
+void job_queue_load(JobQueue *jq, FILE *in);
+
 void job_queue_set_name(JobQueue *jq, int ei, const char *name);
 void job_queue_print_results(JobQueue *jq, size_t frequency);
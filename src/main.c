@@ -12,17 +12,22 @@
  * You should have received a copy of the GNU General Public License along with this program. If
  * not, see <http://www.gnu.org/licenses/>.
  */
+#include "dedup.h"
 #include "engine.h"
 #include "game.h"
+#include "gzip.h"
+#include "ioloop.h"
 #include "jobs.h"
 #include "openings.h"
 #include "options.h"
 #include "seqwriter.h"
+#include "shardwriter.h"
 #include "sprt.h"
 #include "util.h"
 #include "vec.h"
 #include "workers.h"
 #include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,14 +35,29 @@ static Options options;
 static EngineOptions *vecEO;
 static Openings openings;
 static SeqWriter pgnSeqWriter;
-static FILE *sampleFile;
+static SeqWriter sampleSeqWriter;
+static ShardWriter *vecSampleShards; // one sample file per worker, with -sample shard=y
+static Dedup dedup;                  // keys of the samples written, with -sample dedup=MB
 static JobQueue jq;
+static IOLoop *vecLoops;
+
+// Game completions (PGN, samples, results) take a read lock, and checkpoints a write lock, so that
+// a checkpoint never sees a game partially recorded.
+static pthread_rwlock_t progressLock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t checkpointMtx = PTHREAD_MUTEX_INITIALIZER; // one checkpoint at a time
+static int64_t lastCheckpoint;
 
 static void main_destroy(void) {
+    vec_destroy_rec(vecLoops, io_loop_destroy);
     vec_destroy_rec(vecWorkers, worker_destroy);
 
-    if (options.sp.fileName.len)
-        fclose(sampleFile);
+    if (options.sp.fileName.len && !options.sp.shard)
+        seq_writer_destroy(&sampleSeqWriter);
+
+    vec_destroy_rec(vecSampleShards, shard_writer_destroy);
+
+    if (options.sp.dedup)
+        dedup_destroy(&dedup);
 
     if (options.pgn.len)
         seq_writer_destroy(&pgnSeqWriter);
@@ -48,25 +68,90 @@ static void main_destroy(void) {
     vec_destroy_rec(vecEO, engine_options_destroy);
 }
 
+// Output file encoding: binary samples in blocks (format=bin2), and compression for .gz files
+static int output_flags(str_t fileName, bool blocks) {
+    return (blocks ? ENCODE_BLOCKS : 0) | (gzip_file_name(fileName.buf) ? ENCODE_GZIP : 0);
+}
+
+static SeqWriter seq_writer_open(str_t fileName, bool bin, int flags) {
+    return seq_writer_init(fileName.buf, bin || flags ? "a" FOPEN_BINARY : "a" FOPEN_TEXT, flags,
+                           options.flushMsec, options.flushBytes, options.maxQueued);
+}
+
+// Sample file of worker 'id'
+static ShardWriter shard_writer_open(str_t fileName, bool bin, int flags, int id) {
+    scope(str_destroy) str_t shardName = str_init();
+    shard_file_name(fileName.buf, id, &shardName);
+
+    return shard_writer_init(shardName.buf, bin || flags ? "a" FOPEN_BINARY : "a" FOPEN_TEXT, flags,
+                             options.flushBytes);
+}
+
 static void main_init(int argc, const char **argv) {
     atexit(main_destroy);
 
+#ifndef __MINGW32__
+    // Writing to a terminated engine must not kill us (see engine_writeln())
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
     options = options_init();
     vecEO = options_parse(argc, argv, &options);
 
-    jq = job_queue_init((int)vec_size(vecEO), options.rounds, options.games, options.gauntlet);
-    openings = openings_init(options.openings.buf, options.random, options.srand);
+    // Resume from checkpoint: it starts with the openings seed. Otherwise, choose the seed here (if
+    // not specified) so that checkpoints can record it.
+    scope(file_close) FILE *resume = NULL;
+
+    if (options.resume.len) {
+        DIE_IF(!(resume = fopen(options.resume.buf, "r" FOPEN_BINARY)));
+
+        if (fscanf(resume, "c-chess-cli checkpoint srand %" SCNu64, &options.srand) != 1)
+            DIE("invalid checkpoint '%s'\n", options.resume.buf);
+    } else if (!options.srand)
+        options.srand = (uint64_t)system_msec();
+
+    jq = job_queue_init((int)vec_size(vecEO), options.rounds, options.games, options.gauntlet,
+                        options.sprt && options.sprtParam.pentanomial);
+    openings = openings_init(options.openings.buf, options.book.buf, options.order,
+                             options.srand, options.openingsPgn, options.plies);
 
     if (options.pgn.len)
-        pgnSeqWriter = seq_writer_init(options.pgn.buf, "a" FOPEN_TEXT);
+        pgnSeqWriter = seq_writer_open(options.pgn, false, output_flags(options.pgn, false));
+
+    const int sampleFlags = output_flags(options.sp.fileName, options.sp.blocks);
+
+    if (options.sp.fileName.len && options.sp.shard) {
+        vecSampleShards = vec_init(ShardWriter);
+
+        for (int i = 0; i < options.concurrency; i++) {
+            const ShardWriter sw =
+                shard_writer_open(options.sp.fileName, options.sp.bin, sampleFlags, i + 1);
+            vec_push(vecSampleShards, sw);
+        }
+    } else if (options.sp.fileName.len)
+        sampleSeqWriter = seq_writer_open(options.sp.fileName, options.sp.bin, sampleFlags);
+
+    if (options.sp.dedup)
+        dedup = dedup_init(options.sp.dedup);
+
+    if (resume) {
+        job_queue_load(&jq, resume);
+
+        if (options.pgn.len)
+            seq_writer_load(&pgnSeqWriter, resume);
 
-    if (options.sp.fileName.len) {
-        if (options.sp.bin)
-            DIE_IF(!(sampleFile = fopen(options.sp.fileName.buf, "a" FOPEN_BINARY)));
-        else
-            DIE_IF(!(sampleFile = fopen(options.sp.fileName.buf, "a" FOPEN_TEXT)));
+        if (options.sp.fileName.len && !options.sp.shard)
+            seq_writer_load(&sampleSeqWriter, resume);
+
+        for (size_t i = 0; i < vec_size(vecSampleShards); i++)
+            shard_writer_load(&vecSampleShards[i], resume);
+
+        if (options.sp.dedup)
+            dedup_load(&dedup, resume);
     }
 
+    lastCheckpoint = system_msec();
+
     // Prepare vecWorkers[]
     vecWorkers = vec_init(Worker);
 
@@ -78,12 +163,72 @@ static void main_init(int argc, const char **argv) {
 
         vec_push(vecWorkers, worker_init(i, logName.buf));
     }
+
+    // Prepare vecLoops[], in event driven mode
+    vecLoops = vec_init(IOLoop);
+
+    for (int i = 0; i < options.ioThreads; i++)
+        vec_push(vecLoops, io_loop_init());
+}
+
+static void main_checkpoint(bool force) {
+    const int64_t interval = options.checkpointInterval * 1000LL;
+
+    if (!force && system_msec() - __atomic_load_n(&lastCheckpoint, __ATOMIC_RELAXED) < interval)
+        return;
+
+    pthread_mutex_lock(&checkpointMtx);
+
+    // Check again: another worker may have written a checkpoint while we were waiting for the lock
+    if (force || system_msec() - lastCheckpoint >= interval) {
+        // Write to a temporary file, then replace the checkpoint, which is never left incomplete
+        scope(str_destroy) str_t tmpName = str_init_from(options.checkpoint);
+        str_cat_c(&tmpName, ".tmp");
+
+        FILE *out = fopen(tmpName.buf, "w" FOPEN_BINARY);
+        DIE_IF(!out);
+        DIE_IF(fprintf(out, "c-chess-cli checkpoint\nsrand %" PRIu64 "\n", options.srand) < 0);
+
+        Dedup snapshot = {0};
+        pthread_rwlock_wrlock(&progressLock);
+
+        job_queue_save(&jq, out);
+
+        if (options.pgn.len)
+            seq_writer_save(&pgnSeqWriter, out);
+
+        if (options.sp.fileName.len && !options.sp.shard)
+            seq_writer_save(&sampleSeqWriter, out);
+
+        for (size_t i = 0; i < vec_size(vecSampleShards); i++)
+            shard_writer_save(&vecSampleShards[i], out);
+
+        // The dedup table can be large: only copy it while holding the lock, and write it after
+        if (options.sp.dedup)
+            snapshot = dedup_snapshot(&dedup);
+
+        pthread_rwlock_unlock(&progressLock);
+
+        if (options.sp.dedup) {
+            dedup_save(&snapshot, out);
+            dedup_destroy(&snapshot);
+        }
+
+        DIE_IF(file_sync(out) < 0);
+        DIE_IF(fclose(out) < 0);
+        DIE_IF(file_replace(tmpName.buf, options.checkpoint.buf) < 0);
+
+        __atomic_store_n(&lastCheckpoint, system_msec(), __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&checkpointMtx);
 }
 
 static void *thread_start(void *arg) {
     Worker *w = arg;
     threadId = w->id;
     Engine engines[2] = {0};
+    EnginePool pool = engine_pool_init((size_t)options.enginePool);
 
     scope(str_destroy) str_t fen = str_init();
     Job job = {0};
@@ -91,38 +236,35 @@ static void *thread_start(void *arg) {
                  -1}; // vecEO[ei[0]] plays vecEO[ei[1]]: initialize with invalid values to start
     size_t idx = 0, count = 0; // game idx and count (shared across vecWorkers)
 
-    while (job_queue_pop(&jq, &job, &idx, &count)) {
-        // Engine stop/start, as needed
+    // With -affinity, prefer jobs of the same pair as the previous one, to avoid switching engines
+    while (job_queue_pop(&jq, options.affinity && ei[0] >= 0 ? job.pair : -1, &job, &idx, &count)) {
+        // Engine stop/start, as needed. Release both engines first, so that an engine can be
+        // reused in the other seat (eg. pair (A,B) followed by (B,C)).
+        for (int i = 0; i < 2; i++)
+            if (job.ei[i] != ei[i] && engines[i].out)
+                engine_pool_put(&pool, w, ei[i], &engines[i]);
+
         for (int i = 0; i < 2; i++)
             if (job.ei[i] != ei[i]) {
                 ei[i] = job.ei[i];
 
-                if (engines[i].in)
-                    engine_destroy(w, &engines[i]);
-
-                engines[i] = engine_init(w, vecEO[ei[i]].cmd.buf, vecEO[ei[i]].name.buf,
-                                         vecEO[ei[i]].vecOptions, vecEO[ei[i]].timeOut);
-                job_queue_set_name(&jq, ei[i], engines[i].name.buf);
+                if (!engine_pool_get(&pool, ei[i], &engines[i])) {
+                    engines[i] = engine_init(w, vecEO[ei[i]].cmd.buf, vecEO[ei[i]].name.buf,
+                                             vecEO[ei[i]].vecOptions, vecEO[ei[i]].timeOut);
+                    job_queue_set_name(&jq, ei[i], engines[i].name.buf);
+                }
             }
 
         Game game = game_init(job.round, job.game);
 
         // Choose opening position
-        int color = 0;
-        bool ok = false;
-
-        while (!ok) {
-            openings_next(&openings, &fen, options.repeat ? idx / 2 : idx);
-            ok = game_load_fen(&game, fen.buf, &color);
-
-            if (!ok) {
-                stdio_lock(stdout); // lock both stderr and stdout to prevent interleaving
-                fprintf(stderr, "[%d] Illegal FEN '%s'\n", threadId, fen.buf);
-                stdio_unlock(stdout);
-            }
+        while (!openings_next(&openings, &game.vecPos, &fen, options.repeat ? idx / 2 : idx)) {
+            stdio_lock(stdout); // lock both stderr and stdout to prevent interleaving
+            fprintf(stderr, "[%d] Illegal opening '%s'\n", threadId, fen.buf);
+            stdio_unlock(stdout);
         }
 
-        const int whiteIdx = color ^ job.reverse;
+        const int whiteIdx = game.vecPos[vec_size(game.vecPos) - 1].turn ^ job.reverse;
 
         printf("[%d] Started game %zu of %zu (%s vs %s)\n", threadId, idx + 1, count,
                engines[whiteIdx].name.buf, engines[opposite(whiteIdx)].name.buf);
@@ -130,16 +272,57 @@ static void *thread_start(void *arg) {
         const EngineOptions *eoPair[2] = {&vecEO[ei[0]], &vecEO[ei[1]]};
         const int wld = game_play(w, &game, &options, engines, eoPair, job.reverse);
 
-        // Write to PGN file
-        if (options.pgn.len) {
-            scope(str_destroy) str_t pgnText = str_init();
+        // Engines that became unresponsive are killed and respawned for the next job
+        for (int i = 0; i < 2; i++)
+            if (engines[i].unresponsive)
+                ei[i] = -1;
+
+        // Void game: an engine was unresponsive before it started. It is played again later.
+        if (wld == NB_RESULT) {
+            job_queue_add_result(&jq, idx, job.pair, wld);
+            game_destroy(&game);
+            continue;
+        }
+
+        scope(str_destroy) str_t pgnText = str_init();
+        char *vecSamples = vec_init(char);
+
+        if (options.pgn.len)
             game_export_pgn(&game, options.pgnVerbosity, &pgnText);
-            seq_writer_push(&pgnSeqWriter, idx, pgnText);
+
+        pthread_rwlock_rdlock(&progressLock);
+
+        // Drop duplicate samples. Done under the lock, so that a checkpoint only has the keys of
+        // samples written, and not of a game that is played again on resume.
+        if (options.sp.dedup) {
+            size_t n = 0;
+
+            for (size_t i = 0; i < vec_size(game.vecSamples); i++)
+                if (dedup_insert(&dedup, game.vecSamples[i].pos.key))
+                    game.vecSamples[n++] = game.vecSamples[i];
+
+            vec_ptr(game.vecSamples)->size = n;
         }
 
-        // Write to Sample file
         if (options.sp.fileName.len)
-            game_export_samples(&game, sampleFile, options.sp.bin);
+            game_export_samples(&game, options.sp.bin, &vecSamples);
+
+        // Write to PGN and sample files
+        if (options.pgn.len)
+            seq_writer_push(&pgnSeqWriter, idx, pgnText.buf, pgnText.len);
+
+        if (options.sp.fileName.len && options.sp.shard)
+            shard_writer_push(&vecSampleShards[w->id - 1], vecSamples, vec_size(vecSamples));
+        else if (options.sp.fileName.len)
+            seq_writer_push(&sampleSeqWriter, idx, vecSamples, vec_size(vecSamples));
+
+        vec_destroy(vecSamples);
+
+        // Pair update
+        const Result r = job_queue_add_result(&jq, idx, job.pair, wld);
+        const int *wldCount = r.count;
+
+        pthread_rwlock_unlock(&progressLock);
 
         // Write to stdout a one line summary of the game
         scope(str_destroy) str_t result = str_init(), reason = str_init();
@@ -149,16 +332,16 @@ static void *thread_start(void *arg) {
                engines[whiteIdx].name.buf, engines[opposite(whiteIdx)].name.buf, result.buf,
                reason.buf);
 
-        // Pair update
-        int wldCount[3] = {0};
-        job_queue_add_result(&jq, job.pair, wld, wldCount);
+        if (options.checkpoint.len)
+            main_checkpoint(false);
+
         const int n = wldCount[RESULT_WIN] + wldCount[RESULT_LOSS] + wldCount[RESULT_DRAW];
         printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n", engines[0].name.buf,
                engines[1].name.buf, wldCount[RESULT_WIN], wldCount[RESULT_LOSS],
                wldCount[RESULT_DRAW], (wldCount[RESULT_WIN] + 0.5 * wldCount[RESULT_DRAW]) / n, n);
 
         // SPRT update
-        if (options.sprt && sprt_done(wldCount, &options.sprtParam))
+        if (options.sprt && sprt_done(wldCount, r.penta, &options.sprtParam))
             job_queue_stop(&jq);
 
         // Tournament update
@@ -171,6 +354,8 @@ static void *thread_start(void *arg) {
     for (int i = 0; i < 2; i++)
         engine_destroy(w, &engines[i]);
 
+    engine_pool_drain(&pool, w);
+    engine_pool_destroy(&pool);
     return NULL;
 }
 
@@ -180,39 +365,47 @@ int main(int argc, const char **argv) {
         return 0;
     }
 
-    main_init(argc, argv);
+    if (argc == 4 && !strcmp(argv[1], "-book")) {
+        openings_convert(argv[2], argv[3]);
+        return 0;
+    }
+
+    if (argc >= 4 && !strcmp(argv[1], "-merge")) {
+        shard_writer_merge(argv[2], &argv[3], argc - 3);
+        return 0;
+    }
+
+    if ((argc == 4 || argc == 5) && !strcmp(argv[1], "-polyglot")) {
+        openings_polyglot(argv[2], argv[3], argc == 5 ? atoi(argv[4]) : 0);
+        return 0;
+    }
 
-    // Start threads[]
-    pthread_t threads[options.concurrency];
+    main_init(argc, argv);
 
-    for (int i = 0; i < options.concurrency; i++)
-        pthread_create(&threads[i], NULL, thread_start, &vecWorkers[i]);
+    // Start threads[]: either one per worker, or one per event loop (each running its share of
+    // workers as coroutines).
+    const int threadCount = options.ioThreads ? options.ioThreads : options.concurrency;
+    pthread_t threads[threadCount];
 
-    // Main thread loop: check deadline overdue at regular intervals
-    do {
-        system_sleep(100);
+    if (options.ioThreads) {
+        for (int i = 0; i < options.concurrency; i++)
+            io_loop_add(&vecLoops[i % options.ioThreads], &vecWorkers[i], thread_start);
 
-        // We want some tolerance on small delays here. Given a choice, it's best to wait for the
-        // worker thread to notice an overdue deadline, which it will handled nicely by counting the
-        // game as lost for the offending engine, and continue. Enforcing deadlines from the master
-        // thread is the last resort solution, because it is an unrecovrable error. At this point we
-        // are likely to face a completely unresponsive engine, where any attempt at I/O will block
-        // the master thread, on top of the already blocked worker. Hence, we must DIE().
+        for (int i = 0; i < options.ioThreads; i++)
+            pthread_create(&threads[i], NULL, io_loop_run, &vecLoops[i]);
+    } else
         for (int i = 0; i < options.concurrency; i++)
-            if (deadline_overdue(&vecWorkers[i])) {
-                DIE_IF(fprintf(vecWorkers[i].log,
-                               "deadline_clear: now is T1=%" PRId64
-                               ". %s responded after T0+D=%" PRId64 ". fatal error!\n",
-                               system_msec(), vecWorkers[i].deadline.engineName.buf,
-                               vecWorkers[i].deadline.timeLimit) < 0);
-                DIE("[%d] engine %s is unresponsive\n", vecWorkers[i].id,
-                    vecWorkers[i].deadline.engineName.buf);
-            }
-    } while (!job_queue_done(&jq));
+            pthread_create(&threads[i], NULL, thread_start, &vecWorkers[i]);
 
     // Join threads[]
-    for (int i = 0; i < options.concurrency; i++)
+    for (int i = 0; i < threadCount; i++)
         pthread_join(threads[i], NULL);
 
+    if (options.checkpoint.len)
+        main_checkpoint(true);
+
+    if (options.sp.dedup)
+        printf("Samples: %zu written, %zu duplicates dropped\n", dedup.kept, dedup.dropped);
+
     return 0;
 }
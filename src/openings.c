@@ -13,65 +13,920 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #include "openings.h"
+#include "gen.h"
 #include "util.h"
 #include "vec.h"
 #include <assert.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
 
-Openings openings_init(const char *fileName, bool random, uint64_t srand) {
-    Openings o = {.vecIndex = vec_init(size_t)};
+// Binary book: header, followed by fixed size records of pre-validated positions
+static const char BookMagic[8] = "CCCBOOK1";
 
-    if (*fileName)
-        DIE_IF(!(o.file = fopen(fileName, "r" FOPEN_TEXT)));
+typedef struct {
+    char magic[8];
+    uint64_t count; // number of records
+} BookHeader;
 
-    if (o.file) {
-        // Fill o.vecIndex[] to record file offsets for each lines
-        scope(str_destroy) str_t line = str_init();
+enum { PACKED_SIZE = offsetof(PackedPos, packedPieces) + sizeof(((PackedPos *)0)->packedPieces) };
 
-        do {
-            vec_push(o.vecIndex, ftell(o.file));
-        } while (str_getline(&line, o.file));
+typedef struct {
+    uint8_t packed[PACKED_SIZE]; // PackedPos, without its padding
+    uint8_t chess960;
+    uint16_t fullMove;
+    uint8_t reserved[4];
+} BookRecord;
 
-        vec_pop(o.vecIndex); // EOF offset must be removed
+_Static_assert(sizeof(BookHeader) == 16 && sizeof(BookRecord) == 32, "book format");
 
-        if (random) {
+// Polyglot book entry: key (8 bytes), move (2), weight (2), learn (4), big endian, sorted by key
+enum { POLYGLOT_ENTRY = 16 };
+
+typedef struct {
+    uint64_t key;
+    move_t move;
+    uint16_t weight;
+} BookMove;
+
+static const char *StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Is 's', at the start of a line, the start of a record? In EPD, each line is a record. In PGN, a
+// game starts with a tag line, which does not follow another tag line (ignoring blank lines).
+static bool record_start(const char *map, const char *s, bool pgn) {
+    if (!pgn)
+        return true;
+
+    if (*s != '[')
+        return false;
+
+    // Look back for the previous non blank line
+    while (s > map) {
+        const char *end = s - 1; // '\n' terminating the previous line
+        s = end;
+
+        while (s > map && s[-1] != '\n')
+            s--;
+
+        const char *c = s;
+
+        while (c < end && isspace((unsigned char)*c))
+            c++;
+
+        if (c < end)
+            return *c != '[';
+    }
+
+    return true;
+}
+
+// Chunk of the file, whose records are counted or indexed by a thread
+typedef struct {
+    const char *map;
+    size_t begin, end, size;
+    size_t step; // index every step-th record
+    size_t line; // record number of the first record starting in the chunk (or count of records)
+    size_t *vecIndex;
+    bool pgn;
+} IndexChunk;
+
+// Start of the line following 's' (or the first line, if s is NULL), or NULL at the end of the
+// chunk. A line belongs to the chunk that contains the '\n' preceding it.
+static const char *chunk_next(const IndexChunk *c, const char *s) {
+    if (!s) {
+        if (!c->begin)
+            return c->map;
+
+        s = c->map + c->begin;
+    }
+
+    s = memchr(s, '\n', (size_t)(c->map + c->end - s));
+    return s && ++s < c->map + c->size ? s : NULL;
+}
+
+static void *count_chunk(void *arg) {
+    IndexChunk *c = arg;
+    c->line = 0;
+
+    for (const char *s = chunk_next(c, NULL); s; s = chunk_next(c, s))
+        c->line += record_start(c->map, s, c->pgn);
+
+    return NULL;
+}
+
+static void *index_chunk(void *arg) {
+    IndexChunk *c = arg;
+
+    for (const char *s = chunk_next(c, NULL); s; s = chunk_next(c, s))
+        if (record_start(c->map, s, c->pgn) && c->line++ % c->step == 0)
+            vec_push(c->vecIndex, (size_t)(s - c->map));
+
+    return NULL;
+}
+
+// Run func() on each chunk, using one thread per chunk
+static void run_chunks(IndexChunk *chunks, size_t n, void *(*func)(void *)) {
+    pthread_t tids[n];
+
+    for (size_t i = 1; i < n; i++)
+        pthread_create(&tids[i], NULL, func, &chunks[i]);
+
+    func(&chunks[0]);
+
+    for (size_t i = 1; i < n; i++)
+        pthread_join(tids[i], NULL);
+}
+
+// Fill o->vecIndex[] to record offsets of each record (line or game), or only the first record of
+// each block in streaming mode. For large files, split the work among threads, each scanning a
+// chunk of the file, then concatenate the results in order.
+static void index_lines(Openings *o, size_t step) {
+    enum { MIN_CHUNK = 1 << 20 };
+    const size_t threads = min((size_t)system_cpus(), o->size / MIN_CHUNK + 1);
+    IndexChunk chunks[threads];
+
+    for (size_t i = 0; i < threads; i++)
+        chunks[i] = (IndexChunk){.map = o->map,
+                                 .begin = o->size * i / threads,
+                                 .end = o->size * (i + 1) / threads,
+                                 .size = o->size,
+                                 .step = step,
+                                 .pgn = o->pgn,
+                                 .vecIndex =
+                                     vec_init_reserve(o->size / threads / 64 / step, size_t)};
+
+    // Streaming mode: count records first, so each chunk knows the number of its first record
+    o->lines = 0;
+
+    if (step > 1) {
+        run_chunks(chunks, threads, count_chunk);
+
+        for (size_t i = 0; i < threads; i++) {
+            const size_t count = chunks[i].line;
+            chunks[i].line = o->lines;
+            o->lines += count;
+        }
+    }
+
+    run_chunks(chunks, threads, index_chunk);
+
+    for (size_t i = 0; i < threads; i++) {
+        const size_t n = vec_size(chunks[i].vecIndex);
+        o->vecIndex = vec_do_grow(o->vecIndex, sizeof(size_t), n);
+        memcpy(&o->vecIndex[vec_size(o->vecIndex)], chunks[i].vecIndex, n * sizeof(size_t));
+        vec_ptr(o->vecIndex)->size += n;
+        vec_destroy(chunks[i].vecIndex);
+    }
+
+    if (step == 1)
+        o->lines = vec_size(o->vecIndex);
+}
+
+// Binary book: o->vecIndex[] records the number of each record (random order), or the first record
+// of each block (stream-shuffle order). Records are accessed directly in other orders.
+static void index_records(Openings *o, const char *fileName) {
+    BookHeader header = {0};
+    memcpy(&header, o->map, sizeof(header));
+    o->lines = header.count;
+
+    if (!o->lines || o->size != sizeof(BookHeader) + o->lines * sizeof(BookRecord))
+        DIE("invalid book '%s'\n", fileName);
+
+    if (o->order == ORDER_RANDOM)
+        for (size_t i = 0; i < o->lines; i++)
+            vec_push(o->vecIndex, i);
+    else if (o->order == ORDER_STREAM_SHUFFLE)
+        for (size_t i = 0; i < o->lines; i += OPENINGS_BLOCK)
+            vec_push(o->vecIndex, i);
+}
+
+// Keyed permutation of [0, n), using a bijection of [0, 2^bits) and cycle walking
+static size_t permute(size_t x, size_t n, uint64_t seed) {
+    int bits = 0;
+
+    while (((size_t)1 << bits) < n)
+        bits++;
+
+    const size_t mask = ((size_t)1 << bits) - 1;
+    const int shift = bits / 2 + 1;
+    uint64_t keys[3];
+
+    for (int i = 0; i < 3; i++)
+        keys[i] = prng(&seed);
+
+    do {
+        for (int i = 0; i < 3; i++) {
+            x = ((x ^ (keys[i] & mask)) * ((keys[i] >> 32) | 1)) & mask;
+            x ^= x >> shift;
+        }
+    } while (x >= n);
+
+    return x;
+}
+
+Openings openings_init(const char *fileName, const char *bookName, int order, uint64_t srand,
+                       bool pgn, int plies) {
+    Openings o = {.vecIndex = vec_init(size_t), .order = order, .plies = plies};
+    uint64_t seed = srand ? srand : (uint64_t)system_msec();
+
+    if (*bookName && (!(o.polyglot = file_map(bookName, &o.polyglotSize)) ||
+                      o.polyglotSize % POLYGLOT_ENTRY))
+        DIE("invalid book '%s'\n", bookName);
+
+    if (*fileName) {
+        if (!(o.map = file_map(fileName, &o.size)))
+            DIE("openings file '%s' is empty\n", fileName);
+
+        o.book = o.size >= sizeof(BookHeader) && !memcmp(o.map, BookMagic, sizeof(BookMagic));
+
+        o.pgn = pgn && !o.book;
+
+        if (o.book)
+            index_records(&o, fileName);
+        else
+            index_lines(&o, order >= ORDER_STREAM ? OPENINGS_BLOCK : 1);
+
+        if (!o.lines)
+            DIE("no openings found in '%s'\n", fileName);
+
+        if (order == ORDER_RANDOM) {
             // Shuffle o.vecIndex[], which will be read sequentially from the beginning. This allows
             // consistent treatment of random and !random, and guarantees no repetition N-cycles in
             // the random case, rather than sqrt(N) (birthday paradox) if random seek each time.
-            const size_t n = vec_size(o.vecIndex);
-            uint64_t seed = srand ? srand : (uint64_t)system_msec();
-
-            for (size_t i = n - 1; i > 0; i--) {
+            for (size_t i = o.lines - 1; i > 0; i--) {
                 const size_t j = prng(&seed) % (i + 1);
                 swap(o.vecIndex[i], o.vecIndex[j]);
             }
+        } else if (order == ORDER_STREAM_SHUFFLE) {
+            // Shuffle the blocks, except the last one if incomplete (so that it stays last, and the
+            // block of a line remains line / OPENINGS_BLOCK). Lines are permuted within each block
+            // in openings_next().
+            const size_t blocks = o.lines / OPENINGS_BLOCK;
+
+            for (size_t i = blocks; i > 1; i--) {
+                const size_t j = prng(&seed) % i;
+                swap(o.vecIndex[i - 1], o.vecIndex[j]);
+            }
+
         }
     }
 
-    pthread_mutex_init(&o.mtx, NULL);
+    o.seed = prng(&seed);
     return o;
 }
 
 void openings_destroy(Openings *o) {
-    if (o->file)
-        DIE_IF(fclose(o->file) < 0);
-
-    pthread_mutex_destroy(&o->mtx);
+    file_unmap(o->map, o->size);
+    file_unmap(o->polyglot, o->polyglotSize);
     vec_destroy(o->vecIndex);
 }
 
-void openings_next(Openings *o, str_t *fen, size_t idx) {
-    if (!o->file) {
-        str_cpy_c(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-        return;
+// Convert SAN move to move_t, by comparing it with the SAN of each legal move. Returns 0 if
+// illegal.
+static move_t san_to_move(const Position *pos, const char *san, move_t **vecMoves) {
+    scope(str_destroy) str_t legal = str_init();
+    *vecMoves = gen_all_moves(pos, *vecMoves);
+
+    for (size_t i = 0; i < vec_size(*vecMoves); i++) {
+        pos_move_to_san(pos, (*vecMoves)[i], &legal);
+
+        if (!strcmp(legal.buf, san))
+            return (*vecMoves)[i];
+    }
+
+    return 0;
+}
+
+// Read PGN game at 's' into *vecPos: starting position from the FEN tag (if any), followed by the
+// positions after each move of the main line (up to o->plies, if not zero).
+static bool read_pgn(const Openings *o, const char *s, Position **vecPos, str_t *fen) {
+    const char *eof = o->map + o->size;
+    scope(str_destroy) str_t token = str_init();
+    bool chess960 = false;
+    str_cpy_c(fen, StartFEN);
+
+    // Tag pairs: only FEN and Variant are used
+    while (true) {
+        while (s < eof && isspace((unsigned char)*s))
+            s++;
+
+        if (s == eof || *s != '[')
+            break;
+
+        const char *end = memchr(s, '\n', (size_t)(eof - s));
+        end = end ? end : eof;
+        const char *value = memchr(s, '"', (size_t)(end - s));
+        const char *valueEnd = value ? memchr(value + 1, '"', (size_t)(end - value - 1)) : NULL;
+
+        if (valueEnd) {
+            value++;
+            const size_t n = (size_t)(valueEnd - value);
+
+            if (!strncmp(s, "[FEN ", 5))
+                str_ncpy(fen, (str_t){.buf = (char *)value, .len = n}, n);
+            else if (!strncmp(s, "[Variant ", 9))
+                chess960 = (n == 8 && !strncmp(value, "Chess960", n)) ||
+                           (n == 12 && !strncmp(value, "fischerandom", n));
+        }
+
+        s = end;
     }
 
-    // Read 'fen' from file
-    scope(str_destroy) str_t line = str_init();
+    vec_clear(*vecPos);
+    vec_push(*vecPos, (Position){0});
+
+    if (!pos_set(&(*vecPos)[0], fen->buf, chess960))
+        return false;
+
+    // Movetext: skip comments, variations, NAGs, and move numbers
+    move_t *vecMoves = vec_init(move_t);
+    int variations = 0;
+    bool ok = true;
+
+    while (s < eof && (!o->plies || vec_size(*vecPos) <= (size_t)o->plies)) {
+        if (isspace((unsigned char)*s)) {
+            s++;
+            continue;
+        }
+
+        if (*s == '{' || *s == ';') {
+            const char *end = memchr(s, *s == '{' ? '}' : '\n', (size_t)(eof - s));
+            s = end ? end + 1 : eof;
+            continue;
+        }
+
+        if (*s == '(' || *s == ')') {
+            variations += *s++ == '(' ? 1 : -1;
+            continue;
+        }
+
+        if (*s == '[' && s[-1] == '\n')
+            break; // next game
+
+        const char *end = s;
+
+        while (end < eof && !isspace((unsigned char)*end) && !strchr("{}();", *end))
+            end++;
+
+        const char *san = s;
+        s = end;
+
+        if (variations || *san == '$')
+            continue;
+
+        // Move number, possibly attached to the move (eg. "1.e4" or "1...e5")
+        const char *dots = san;
+
+        while (dots < end && isdigit((unsigned char)*dots))
+            dots++;
+
+        if (dots > san && dots < end && *dots == '.') {
+            while (dots < end && *dots == '.')
+                dots++;
+
+            san = dots;
+        }
+
+        str_ncpy(&token, (str_t){.buf = (char *)san, .len = (size_t)(end - san)},
+                 (size_t)(end - san));
 
-    pthread_mutex_lock(&o->mtx);
-    DIE_IF(fseek(o->file, o->vecIndex[idx % vec_size(o->vecIndex)], SEEK_SET) < 0);
-    DIE_IF(!str_getline(&line, o->file));
-    pthread_mutex_unlock(&o->mtx);
+        if (!token.len)
+            continue;
+
+        if (!strcmp(token.buf, "1-0") || !strcmp(token.buf, "0-1") ||
+            !strcmp(token.buf, "1/2-1/2") || !strcmp(token.buf, "*"))
+            break;
+
+        // Remove check and annotation suffixes, and accept castling with zeros
+        while (token.len && strchr("+#!?", token.buf[token.len - 1]))
+            token.buf[--token.len] = '\0';
+
+        for (size_t i = 0; i < token.len && (token.buf[i] == '0' || token.buf[i] == '-'); i++)
+            if (token.buf[i] == '0')
+                token.buf[i] = 'O';
+
+        const Position *last = &(*vecPos)[vec_size(*vecPos) - 1];
+        const move_t m = san_to_move(last, token.buf, &vecMoves);
+
+        if (!m) {
+            str_cat_fmt(fen, " (illegal move %S)", token);
+            ok = false;
+            break;
+        }
+
+        Position next;
+        pos_move(&next, last, m);
+        vec_push(*vecPos, next);
+    }
+
+    vec_destroy(vecMoves);
+    return ok;
+}
+
+static bool read_opening(const Openings *o, Position **vecPos, str_t *fen, size_t idx) {
+    if (!o->map) {
+        vec_clear(*vecPos);
+        vec_push(*vecPos, (Position){0});
+        str_cpy_c(fen, StartFEN);
+        return pos_set(&(*vecPos)[0], fen->buf, false);
+    }
+
+    const size_t lineIdx = idx % o->lines;
+    size_t skip = 0; // streaming orders: record number within its block
+
+    if (o->order >= ORDER_STREAM) {
+        const size_t block = lineIdx / OPENINGS_BLOCK;
+        skip = lineIdx % OPENINGS_BLOCK;
+
+        if (o->order == ORDER_STREAM_SHUFFLE)
+            skip = permute(skip, min(o->lines - block * OPENINGS_BLOCK, (size_t)OPENINGS_BLOCK),
+                           o->seed + block);
+    }
+
+    if (o->book) {
+        // Pre-validated position: unpack it, no FEN parsing
+        const size_t record = o->order == ORDER_RANDOM ? o->vecIndex[lineIdx]
+                              : o->order == ORDER_STREAM_SHUFFLE
+                                  ? o->vecIndex[lineIdx / OPENINGS_BLOCK] + skip
+                                  : lineIdx;
+
+        BookRecord r = {0};
+        memcpy(&r, o->map + sizeof(BookHeader) + record * sizeof(BookRecord), sizeof(r));
+
+        PackedPos pp = {0};
+        memcpy(&pp, r.packed, PACKED_SIZE);
+        vec_clear(*vecPos);
+        vec_push(*vecPos, (Position){0});
+        pos_unpack(&(*vecPos)[0], &pp);
+        (*vecPos)[0].chess960 = r.chess960;
+        (*vecPos)[0].fullMove = r.fullMove;
+        str_clear(fen);
+        return true;
+    }
+
+    const char *line = NULL, *eof = o->map + o->size;
+
+    if (o->order >= ORDER_STREAM) {
+        // Find the record in its block, skipping the records before it
+        line = o->map + o->vecIndex[lineIdx / OPENINGS_BLOCK];
+
+        while (skip)
+            if (record_start(o->map,
+                             line = (const char *)memchr(line, '\n', (size_t)(eof - line)) + 1,
+                             o->pgn))
+                skip--;
+    } else
+        line = o->map + o->vecIndex[lineIdx];
+
+    if (o->pgn)
+        return read_pgn(o, line, vecPos, fen);
+
+    // Read 'fen' from the line: first ';' separated token, ignoring '\r' (CR+LF encoded file)
+    const char *end = memchr(line, '\n', (size_t)(eof - line));
+
+    if (!end)
+        end = eof;
+
+    while (line < end && *line == ';')
+        line++;
+
+    const char *tail = memchr(line, ';', (size_t)(end - line));
+    size_t n = (size_t)((tail ? tail : end) - line);
+
+    while (n && line[n - 1] == '\r')
+        n--;
+
+    // 'line' is not '\0' terminated: str_ncpy() only reads its first n characters
+    str_ncpy(fen, (str_t){.buf = (char *)line, .len = n}, n);
+    vec_clear(*vecPos);
+    vec_push(*vecPos, (Position){0});
+    return pos_set(&(*vecPos)[0], fen->buf, false);
+}
+
+static uint64_t read_be(const char *p, int bytes) {
+    uint64_t v = 0;
+
+    for (int i = 0; i < bytes; i++)
+        v = (v << 8) | (uint8_t)p[i];
+
+    return v;
+}
+
+static void write_be(char *p, uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--, v >>= 8)
+        p[i] = (char)(v & 0xFF);
+}
+
+// Random numbers of the Polyglot hash function, from the book format specification: 768 for
+// pieces, 4 for castling rights, 8 for the en passant file, and 1 for the turn.
+static const uint64_t Random64[781] = {
+    0x9D39247E33776D41, 0x2AF7398005AAA5C7, 0x44DB015024623547, 0x9C15F73E62A76AE2,
+    0x75834465489C0C89, 0x3290AC3A203001BF, 0x0FBBAD1F61042279, 0xE83A908FF2FB60CA,
+    0x0D7E765D58755C10, 0x1A083822CEAFE02D, 0x9605D5F0E25EC3B0, 0xD021FF5CD13A2ED5,
+    0x40BDF15D4A672E32, 0x011355146FD56395, 0x5DB4832046F3D9E5, 0x239F8B2D7FF719CC,
+    0x05D1A1AE85B49AA1, 0x679F848F6E8FC971, 0x7449BBFF801FED0B, 0x7D11CDB1C3B7ADF0,
+    0x82C7709E781EB7CC, 0xF3218F1C9510786C, 0x331478F3AF51BBE6, 0x4BB38DE5E7219443,
+    0xAA649C6EBCFD50FC, 0x8DBD98A352AFD40B, 0x87D2074B81D79217, 0x19F3C751D3E92AE1,
+    0xB4AB30F062B19ABF, 0x7B0500AC42047AC4, 0xC9452CA81A09D85D, 0x24AA6C514DA27500,
+    0x4C9F34427501B447, 0x14A68FD73C910841, 0xA71B9B83461CBD93, 0x03488B95B0F1850F,
+    0x637B2B34FF93C040, 0x09D1BC9A3DD90A94, 0x3575668334A1DD3B, 0x735E2B97A4C45A23,
+    0x18727070F1BD400B, 0x1FCBACD259BF02E7, 0xD310A7C2CE9B6555, 0xBF983FE0FE5D8244,
+    0x9F74D14F7454A824, 0x51EBDC4AB9BA3035, 0x5C82C505DB9AB0FA, 0xFCF7FE8A3430B241,
+    0x3253A729B9BA3DDE, 0x8C74C368081B3075, 0xB9BC6C87167C33E7, 0x7EF48F2B83024E20,
+    0x11D505D4C351BD7F, 0x6568FCA92C76A243, 0x4DE0B0F40F32A7B8, 0x96D693460CC37E5D,
+    0x42E240CB63689F2F, 0x6D2BDCDAE2919661, 0x42880B0236E4D951, 0x5F0F4A5898171BB6,
+    0x39F890F579F92F88, 0x93C5B5F47356388B, 0x63DC359D8D231B78, 0xEC16CA8AEA98AD76,
+    0x5355F900C2A82DC7, 0x07FB9F855A997142, 0x5093417AA8A7ED5E, 0x7BCBC38DA25A7F3C,
+    0x19FC8A768CF4B6D4, 0x637A7780DECFC0D9, 0x8249A47AEE0E41F7, 0x79AD695501E7D1E8,
+    0x14ACBAF4777D5776, 0xF145B6BECCDEA195, 0xDABF2AC8201752FC, 0x24C3C94DF9C8D3F6,
+    0xBB6E2924F03912EA, 0x0CE26C0B95C980D9, 0xA49CD132BFBF7CC4, 0xE99D662AF4243939,
+    0x27E6AD7891165C3F, 0x8535F040B9744FF1, 0x54B3F4FA5F40D873, 0x72B12C32127FED2B,
+    0xEE954D3C7B411F47, 0x9A85AC909A24EAA1, 0x70AC4CD9F04F21F5, 0xF9B89D3E99A075C2,
+    0x87B3E2B2B5C907B1, 0xA366E5B8C54F48B8, 0xAE4A9346CC3F7CF2, 0x1920C04D47267BBD,
+    0x87BF02C6B49E2AE9, 0x092237AC237F3859, 0xFF07F64EF8ED14D0, 0x8DE8DCA9F03CC54E,
+    0x9C1633264DB49C89, 0xB3F22C3D0B0B38ED, 0x390E5FB44D01144B, 0x5BFEA5B4712768E9,
+    0x1E1032911FA78984, 0x9A74ACB964E78CB3, 0x4F80F7A035DAFB04, 0x6304D09A0B3738C4,
+    0x2171E64683023A08, 0x5B9B63EB9CEFF80C, 0x506AACF489889342, 0x1881AFC9A3A701D6,
+    0x6503080440750644, 0xDFD395339CDBF4A7, 0xEF927DBCF00C20F2, 0x7B32F7D1E03680EC,
+    0xB9FD7620E7316243, 0x05A7E8A57DB91B77, 0xB5889C6E15630A75, 0x4A750A09CE9573F7,
+    0xCF464CEC899A2F8A, 0xF538639CE705B824, 0x3C79A0FF5580EF7F, 0xEDE6C87F8477609D,
+    0x799E81F05BC93F31, 0x86536B8CF3428A8C, 0x97D7374C60087B73, 0xA246637CFF328532,
+    0x043FCAE60CC0EBA0, 0x920E449535DD359E, 0x70EB093B15B290CC, 0x73A1921916591CBD,
+    0x56436C9FE1A1AA8D, 0xEFAC4B70633B8F81, 0xBB215798D45DF7AF, 0x45F20042F24F1768,
+    0x930F80F4E8EB7462, 0xFF6712FFCFD75EA1, 0xAE623FD67468AA70, 0xDD2C5BC84BC8D8FC,
+    0x7EED120D54CF2DD9, 0x22FE545401165F1C, 0xC91800E98FB99929, 0x808BD68E6AC10365,
+    0xDEC468145B7605F6, 0x1BEDE3A3AEF53302, 0x43539603D6C55602, 0xAA969B5C691CCB7A,
+    0xA87832D392EFEE56, 0x65942C7B3C7E11AE, 0xDED2D633CAD004F6, 0x21F08570F420E565,
+    0xB415938D7DA94E3C, 0x91B859E59ECB6350, 0x10CFF333E0ED804A, 0x28AED140BE0BB7DD,
+    0xC5CC1D89724FA456, 0x5648F680F11A2741, 0x2D255069F0B7DAB3, 0x9BC5A38EF729ABD4,
+    0xEF2F054308F6A2BC, 0xAF2042F5CC5C2858, 0x480412BAB7F5BE2A, 0xAEF3AF4A563DFE43,
+    0x19AFE59AE451497F, 0x52593803DFF1E840, 0xF4F076E65F2CE6F0, 0x11379625747D5AF3,
+    0xBCE5D2248682C115, 0x9DA4243DE836994F, 0x066F70B33FE09017, 0x4DC4DE189B671A1C,
+    0x51039AB7712457C3, 0xC07A3F80C31FB4B4, 0xB46EE9C5E64A6E7C, 0xB3819A42ABE61C87,
+    0x21A007933A522A20, 0x2DF16F761598AA4F, 0x763C4A1371B368FD, 0xF793C46702E086A0,
+    0xD7288E012AEB8D31, 0xDE336A2A4BC1C44B, 0x0BF692B38D079F23, 0x2C604A7A177326B3,
+    0x4850E73E03EB6064, 0xCFC447F1E53C8E1B, 0xB05CA3F564268D99, 0x9AE182C8BC9474E8,
+    0xA4FC4BD4FC5558CA, 0xE755178D58FC4E76, 0x69B97DB1A4C03DFE, 0xF9B5B7C4ACC67C96,
+    0xFC6A82D64B8655FB, 0x9C684CB6C4D24417, 0x8EC97D2917456ED0, 0x6703DF9D2924E97E,
+    0xC547F57E42A7444E, 0x78E37644E7CAD29E, 0xFE9A44E9362F05FA, 0x08BD35CC38336615,
+    0x9315E5EB3A129ACE, 0x94061B871E04DF75, 0xDF1D9F9D784BA010, 0x3BBA57B68871B59D,
+    0xD2B7ADEEDED1F73F, 0xF7A255D83BC373F8, 0xD7F4F2448C0CEB81, 0xD95BE88CD210FFA7,
+    0x336F52F8FF4728E7, 0xA74049DAC312AC71, 0xA2F61BB6E437FDB5, 0x4F2A5CB07F6A35B3,
+    0x87D380BDA5BF7859, 0x16B9F7E06C453A21, 0x7BA2484C8A0FD54E, 0xF3A678CAD9A2E38C,
+    0x39B0BF7DDE437BA2, 0xFCAF55C1BF8A4424, 0x18FCF680573FA594, 0x4C0563B89F495AC3,
+    0x40E087931A00930D, 0x8CFFA9412EB642C1, 0x68CA39053261169F, 0x7A1EE967D27579E2,
+    0x9D1D60E5076F5B6F, 0x3810E399B6F65BA2, 0x32095B6D4AB5F9B1, 0x35CAB62109DD038A,
+    0xA90B24499FCFAFB1, 0x77A225A07CC2C6BD, 0x513E5E634C70E331, 0x4361C0CA3F692F12,
+    0xD941ACA44B20A45B, 0x528F7C8602C5807B, 0x52AB92BEB9613989, 0x9D1DFA2EFC557F73,
+    0x722FF175F572C348, 0x1D1260A51107FE97, 0x7A249A57EC0C9BA2, 0x04208FE9E8F7F2D6,
+    0x5A110C6058B920A0, 0x0CD9A497658A5698, 0x56FD23C8F9715A4C, 0x284C847B9D887AAE,
+    0x04FEABFBBDB619CB, 0x742E1E651C60BA83, 0x9A9632E65904AD3C, 0x881B82A13B51B9E2,
+    0x506E6744CD974924, 0xB0183DB56FFC6A79, 0x0ED9B915C66ED37E, 0x5E11E86D5873D484,
+    0xF678647E3519AC6E, 0x1B85D488D0F20CC5, 0xDAB9FE6525D89021, 0x0D151D86ADB73615,
+    0xA865A54EDCC0F019, 0x93C42566AEF98FFB, 0x99E7AFEABE000731, 0x48CBFF086DDF285A,
+    0x7F9B6AF1EBF78BAF, 0x58627E1A149BBA21, 0x2CD16E2ABD791E33, 0xD363EFF5F0977996,
+    0x0CE2A38C344A6EED, 0x1A804AADB9CFA741, 0x907F30421D78C5DE, 0x501F65EDB3034D07,
+    0x37624AE5A48FA6E9, 0x957BAF61700CFF4E, 0x3A6C27934E31188A, 0xD49503536ABCA345,
+    0x088E049589C432E0, 0xF943AEE7FEBF21B8, 0x6C3B8E3E336139D3, 0x364F6FFA464EE52E,
+    0xD60F6DCEDC314222, 0x56963B0DCA418FC0, 0x16F50EDF91E513AF, 0xEF1955914B609F93,
+    0x565601C0364E3228, 0xECB53939887E8175, 0xBAC7A9A18531294B, 0xB344C470397BBA52,
+    0x65D34954DAF3CEBD, 0xB4B81B3FA97511E2, 0xB422061193D6F6A7, 0x071582401C38434D,
+    0x7A13F18BBEDC4FF5, 0xBC4097B116C524D2, 0x59B97885E2F2EA28, 0x99170A5DC3115544,
+    0x6F423357E7C6A9F9, 0x325928EE6E6F8794, 0xD0E4366228B03343, 0x565C31F7DE89EA27,
+    0x30F5611484119414, 0xD873DB391292ED4F, 0x7BD94E1D8E17DEBC, 0xC7D9F16864A76E94,
+    0x947AE053EE56E63C, 0xC8C93882F9475F5F, 0x3A9BF55BA91F81CA, 0xD9A11FBB3D9808E4,
+    0x0FD22063EDC29FCA, 0xB3F256D8ACA0B0B9, 0xB03031A8B4516E84, 0x35DD37D5871448AF,
+    0xE9F6082B05542E4E, 0xEBFAFA33D7254B59, 0x9255ABB50D532280, 0xB9AB4CE57F2D34F3,
+    0x693501D628297551, 0xC62C58F97DD949BF, 0xCD454F8F19C5126A, 0xBBE83F4ECC2BDECB,
+    0xDC842B7E2819E230, 0xBA89142E007503B8, 0xA3BC941D0A5061CB, 0xE9F6760E32CD8021,
+    0x09C7E552BC76492F, 0x852F54934DA55CC9, 0x8107FCCF064FCF56, 0x098954D51FFF6580,
+    0x23B70EDB1955C4BF, 0xC330DE426430F69D, 0x4715ED43E8A45C0A, 0xA8D7E4DAB780A08D,
+    0x0572B974F03CE0BB, 0xB57D2E985E1419C7, 0xE8D9ECBE2CF3D73F, 0x2FE4B17170E59750,
+    0x11317BA87905E790, 0x7FBF21EC8A1F45EC, 0x1725CABFCB045B00, 0x964E915CD5E2B207,
+    0x3E2B8BCBF016D66D, 0xBE7444E39328A0AC, 0xF85B2B4FBCDE44B7, 0x49353FEA39BA63B1,
+    0x1DD01AAFCD53486A, 0x1FCA8A92FD719F85, 0xFC7C95D827357AFA, 0x18A6A990C8B35EBD,
+    0xCCCB7005C6B9C28D, 0x3BDBB92C43B17F26, 0xAA70B5B4F89695A2, 0xE94C39A54A98307F,
+    0xB7A0B174CFF6F36E, 0xD4DBA84729AF48AD, 0x2E18BC1AD9704A68, 0x2DE0966DAF2F8B1C,
+    0xB9C11D5B1E43A07E, 0x64972D68DEE33360, 0x94628D38D0C20584, 0xDBC0D2B6AB90A559,
+    0xD2733C4335C6A72F, 0x7E75D99D94A70F4D, 0x6CED1983376FA72B, 0x97FCAACBF030BC24,
+    0x7B77497B32503B12, 0x8547EDDFB81CCB94, 0x79999CDFF70902CB, 0xCFFE1939438E9B24,
+    0x829626E3892D95D7, 0x92FAE24291F2B3F1, 0x63E22C147B9C3403, 0xC678B6D860284A1C,
+    0x5873888850659AE7, 0x0981DCD296A8736D, 0x9F65789A6509A440, 0x9FF38FED72E9052F,
+    0xE479EE5B9930578C, 0xE7F28ECD2D49EECD, 0x56C074A581EA17FE, 0x5544F7D774B14AEF,
+    0x7B3F0195FC6F290F, 0x12153635B2C0CF57, 0x7F5126DBBA5E0CA7, 0x7A76956C3EAFB413,
+    0x3D5774A11D31AB39, 0x8A1B083821F40CB4, 0x7B4A38E32537DF62, 0x950113646D1D6E03,
+    0x4DA8979A0041E8A9, 0x3BC36E078F7515D7, 0x5D0A12F27AD310D1, 0x7F9D1A2E1EBE1327,
+    0xDA3A361B1C5157B1, 0xDCDD7D20903D0C25, 0x36833336D068F707, 0xCE68341F79893389,
+    0xAB9090168DD05F34, 0x43954B3252DC25E5, 0xB438C2B67F98E5E9, 0x10DCD78E3851A492,
+    0xDBC27AB5447822BF, 0x9B3CDB65F82CA382, 0xB67B7896167B4C84, 0xBFCED1B0048EAC50,
+    0xA9119B60369FFEBD, 0x1FFF7AC80904BF45, 0xAC12FB171817EEE7, 0xAF08DA9177DDA93D,
+    0x1B0CAB936E65C744, 0xB559EB1D04E5E932, 0xC37B45B3F8D6F2BA, 0xC3A9DC228CAAC9E9,
+    0xF3B8B6675A6507FF, 0x9FC477DE4ED681DA, 0x67378D8ECCEF96CB, 0x6DD856D94D259236,
+    0xA319CE15B0B4DB31, 0x073973751F12DD5E, 0x8A8E849EB32781A5, 0xE1925C71285279F5,
+    0x74C04BF1790C0EFE, 0x4DDA48153C94938A, 0x9D266D6A1CC0542C, 0x7440FB816508C4FE,
+    0x13328503DF48229F, 0xD6BF7BAEE43CAC40, 0x4838D65F6EF6748F, 0x1E152328F3318DEA,
+    0x8F8419A348F296BF, 0x72C8834A5957B511, 0xD7A023A73260B45C, 0x94EBC8ABCFB56DAE,
+    0x9FC10D0F989993E0, 0xDE68A2355B93CAE6, 0xA44CFE79AE538BBE, 0x9D1D84FCCE371425,
+    0x51D2B1AB2DDFB636, 0x2FD7E4B9E72CD38C, 0x65CA5B96B7552210, 0xDD69A0D8AB3B546D,
+    0x604D51B25FBF70E2, 0x73AA8A564FB7AC9E, 0x1A8C1E992B941148, 0xAAC40A2703D9BEA0,
+    0x764DBEAE7FA4F3A6, 0x1E99B96E70A9BE8B, 0x2C5E9DEB57EF4743, 0x3A938FEE32D29981,
+    0x26E6DB8FFDF5ADFE, 0x469356C504EC9F9D, 0xC8763C5B08D1908C, 0x3F6C6AF859D80055,
+    0x7F7CC39420A3A545, 0x9BFB227EBDF4C5CE, 0x89039D79D6FC5C5C, 0x8FE88B57305E2AB6,
+    0xA09E8C8C35AB96DE, 0xFA7E393983325753, 0xD6B6D0ECC617C699, 0xDFEA21EA9E7557E3,
+    0xB67C1FA481680AF8, 0xCA1E3785A9E724E5, 0x1CFC8BED0D681639, 0xD18D8549D140CAEA,
+    0x4ED0FE7E9DC91335, 0xE4DBF0634473F5D2, 0x1761F93A44D5AEFE, 0x53898E4C3910DA55,
+    0x734DE8181F6EC39A, 0x2680B122BAA28D97, 0x298AF231C85BAFAB, 0x7983EED3740847D5,
+    0x66C1A2A1A60CD889, 0x9E17E49642A3E4C1, 0xEDB454E7BADC0805, 0x50B704CAB602C329,
+    0x4CC317FB9CDDD023, 0x66B4835D9EAFEA22, 0x219B97E26FFC81BD, 0x261E4E4C0A333A9D,
+    0x1FE2CCA76517DB90, 0xD7504DFA8816EDBB, 0xB9571FA04DC089C8, 0x1DDC0325259B27DE,
+    0xCF3F4688801EB9AA, 0xF4F5D05C10CAB243, 0x38B6525C21A42B0E, 0x36F60E2BA4FA6800,
+    0xEB3593803173E0CE, 0x9C4CD6257C5A3603, 0xAF0C317D32ADAA8A, 0x258E5A80C7204C4B,
+    0x8B889D624D44885D, 0xF4D14597E660F855, 0xD4347F66EC8941C3, 0xE699ED85B0DFB40D,
+    0x2472F6207C2D0484, 0xC2A1E7B5B459AEB5, 0xAB4F6451CC1D45EC, 0x63767572AE3D6174,
+    0xA59E0BD101731A28, 0x116D0016CB948F09, 0x2CF9C8CA052F6E9F, 0x0B090A7560A968E3,
+    0xABEEDDB2DDE06FF1, 0x58EFC10B06A2068D, 0xC6E57A78FBD986E0, 0x2EAB8CA63CE802D7,
+    0x14A195640116F336, 0x7C0828DD624EC390, 0xD74BBE77E6116AC7, 0x804456AF10F5FB53,
+    0xEBE9EA2ADF4321C7, 0x03219A39EE587A30, 0x49787FEF17AF9924, 0xA1E9300CD8520548,
+    0x5B45E522E4B1B4EF, 0xB49C3B3995091A36, 0xD4490AD526F14431, 0x12A8F216AF9418C2,
+    0x001F837CC7350524, 0x1877B51E57A764D5, 0xA2853B80F17F58EE, 0x993E1DE72D36D310,
+    0xB3598080CE64A656, 0x252F59CF0D9F04BB, 0xD23C8E176D113600, 0x1BDA0492E7E4586E,
+    0x21E0BD5026C619BF, 0x3B097ADAF088F94E, 0x8D14DEDB30BE846E, 0xF95CFFA23AF5F6F4,
+    0x3871700761B3F743, 0xCA672B91E9E4FA16, 0x64C8E531BFF53B55, 0x241260ED4AD1E87D,
+    0x106C09B972D2E822, 0x7FBA195410E5CA30, 0x7884D9BC6CB569D8, 0x0647DFEDCD894A29,
+    0x63573FF03E224774, 0x4FC8E9560F91B123, 0x1DB956E450275779, 0xB8D91274B9E9D4FB,
+    0xA2EBEE47E2FBFCE1, 0xD9F1F30CCD97FB09, 0xEFED53D75FD64E6B, 0x2E6D02C36017F67F,
+    0xA9AA4D20DB084E9B, 0xB64BE8D8B25396C1, 0x70CB6AF7C2D5BCF0, 0x98F076A4F7A2322E,
+    0xBF84470805E69B5F, 0x94C3251F06F90CF3, 0x3E003E616A6591E9, 0xB925A6CD0421AFF3,
+    0x61BDD1307C66E300, 0xBF8D5108E27E0D48, 0x240AB57A8B888B20, 0xFC87614BAF287E07,
+    0xEF02CDD06FFDB432, 0xA1082C0466DF6C0A, 0x8215E577001332C8, 0xD39BB9C3A48DB6CF,
+    0x2738259634305C14, 0x61CF4F94C97DF93D, 0x1B6BACA2AE4E125B, 0x758F450C88572E0B,
+    0x959F587D507A8359, 0xB063E962E045F54D, 0x60E8ED72C0DFF5D1, 0x7B64978555326F9F,
+    0xFD080D236DA814BA, 0x8C90FD9B083F4558, 0x106F72FE81E2C590, 0x7976033A39F7D952,
+    0xA4EC0132764CA04B, 0x733EA705FAE4FA77, 0xB4D8F77BC3E56167, 0x9E21F4F903B33FD9,
+    0x9D765E419FB69F6D, 0xD30C088BA61EA5EF, 0x5D94337FBFAF7F5B, 0x1A4E4822EB4D7A59,
+    0x6FFE73E81B637FB3, 0xDDF957BC36D8B9CA, 0x64D0E29EEA8838B3, 0x08DD9BDFD96B9F63,
+    0x087E79E5A57D1D13, 0xE328E230E3E2B3FB, 0x1C2559E30F0946BE, 0x720BF5F26F4D2EAA,
+    0xB0774D261CC609DB, 0x443F64EC5A371195, 0x4112CF68649A260E, 0xD813F2FAB7F5C5CA,
+    0x660D3257380841EE, 0x59AC2C7873F910A3, 0xE846963877671A17, 0x93B633ABFA3469F8,
+    0xC0C0F5A60EF4CDCF, 0xCAF21ECD4377B28C, 0x57277707199B8175, 0x506C11B9D90E8B1D,
+    0xD83CC2687A19255F, 0x4A29C6465A314CD1, 0xED2DF21216235097, 0xB5635C95FF7296E2,
+    0x22AF003AB672E811, 0x52E762596BF68235, 0x9AEBA33AC6ECC6B0, 0x944F6DE09134DFB6,
+    0x6C47BEC883A7DE39, 0x6AD047C430A12104, 0xA5B1CFDBA0AB4067, 0x7C45D833AFF07862,
+    0x5092EF950A16DA0B, 0x9338E69C052B8E7B, 0x455A4B4CFE30E3F5, 0x6B02E63195AD0CF8,
+    0x6B17B224BAD6BF27, 0xD1E0CCD25BB9C169, 0xDE0C89A556B9AE70, 0x50065E535A213CF6,
+    0x9C1169FA2777B874, 0x78EDEFD694AF1EED, 0x6DC93D9526A50E68, 0xEE97F453F06791ED,
+    0x32AB0EDB696703D3, 0x3A6853C7E70757A7, 0x31865CED6120F37D, 0x67FEF95D92607890,
+    0x1F2B1D1F15F6DC9C, 0xB69E38A8965C6B65, 0xAA9119FF184CCCF4, 0xF43C732873F24C13,
+    0xFB4A3D794A9A80D2, 0x3550C2321FD6109C, 0x371F77E76BB8417E, 0x6BFA9AAE5EC05779,
+    0xCD04F3FF001A4778, 0xE3273522064480CA, 0x9F91508BFFCFC14A, 0x049A7F41061A9E60,
+    0xFCB6BE43A9F2FE9B, 0x08DE8A1C7797DA9B, 0x8F9887E6078735A1, 0xB5B4071DBFC73A66,
+    0x230E343DFBA08D33, 0x43ED7F5A0FAE657D, 0x3A88A0FBBCB05C63, 0x21874B8B4D2DBC4F,
+    0x1BDEA12E35F6A8C9, 0x53C065C6C8E63528, 0xE34A1D250E7A8D6B, 0xD6B04D3B7651DD7E,
+    0x5E90277E7CB39E2D, 0x2C046F22062DC67D, 0xB10BB459132D0A26, 0x3FA9DDFB67E2F199,
+    0x0E09B88E1914F7AF, 0x10E8B35AF3EEAB37, 0x9EEDECA8E272B933, 0xD4C718BC4AE8AE5F,
+    0x81536D601170FC20, 0x91B534F885818A06, 0xEC8177F83F900978, 0x190E714FADA5156E,
+    0xB592BF39B0364963, 0x89C350C893AE7DC1, 0xAC042E70F8B383F2, 0xB49B52E587A1EE60,
+    0xFB152FE3FF26DA89, 0x3E666E6F69AE2C15, 0x3B544EBE544C19F9, 0xE805A1E290CF2456,
+    0x24B33C9D7ED25117, 0xE74733427B72F0C1, 0x0A804D18B7097475, 0x57E3306D881EDB4F,
+    0x4AE7D6A36EB5DBCB, 0x2D8D5432157064C8, 0xD1E649DE1E7F268B, 0x8A328A1CEDFE552C,
+    0x07A3AEC79624C7DA, 0x84547DDC3E203C94, 0x990A98FD5071D263, 0x1A4FF12616EEFC89,
+    0xF6F7FD1431714200, 0x30C05B1BA332F41C, 0x8D2636B81555A786, 0x46C9FEB55D120902,
+    0xCCEC0A73B49C9921, 0x4E9D2827355FC492, 0x19EBB029435DCB0F, 0x4659D2B743848A2C,
+    0x963EF2C96B33BE31, 0x74F85198B05A2E7D, 0x5A0F544DD2B1FB18, 0x03727073C2E134B1,
+    0xC7F6AA2DE59AEA61, 0x352787BAA0D7C22F, 0x9853EAB63B5E0B35, 0xABBDCDD7ED5C0860,
+    0xCF05DAF5AC8D77B0, 0x49CAD48CEBF4A71E, 0x7A4C10EC2158C4A6, 0xD9E92AA246BF719E,
+    0x13AE978D09FE5557, 0x730499AF921549FF, 0x4E4B705B92903BA4, 0xFF577222C14F0A3A,
+    0x55B6344CF97AAFAE, 0xB862225B055B6960, 0xCAC09AFBDDD2CDB4, 0xDAF8E9829FE96B5F,
+    0xB5FDFC5D3132C498, 0x310CB380DB6F7503, 0xE87FBB46217A360E, 0x2102AE466EBB1148,
+    0xF8549E1A3AA5E00D, 0x07A69AFDCC42261A, 0xC4C118BFE78FEAAE, 0xF9F4892ED96BD438,
+    0x1AF3DBE25D8F45DA, 0xF5B4B0B0D2DEEEB4, 0x962ACEEFA82E1C84, 0x046E3ECAAF453CE9,
+    0xF05D129681949A4C, 0x964781CE734B3C84, 0x9C2ED44081CE5FBD, 0x522E23F3925E319E,
+    0x177E00F9FC32F791, 0x2BC60A63A6F3B3F2, 0x222BBFAE61725606, 0x486289DDCC3D6780,
+    0x7DC7785B8EFDFC80, 0x8AF38731C02BA980, 0x1FAB64EA29A2DDF7, 0xE4D9429322CD065A,
+    0x9DA058C67844F20C, 0x24C0E332B70019B0, 0x233003B5A6CFE6AD, 0xD586BD01C5C217F6,
+    0x5E5637885F29BC2B, 0x7EBA726D8C94094B, 0x0A56A5F0BFE39272, 0xD79476A84EE20D06,
+    0x9E4C1269BAA4BF37, 0x17EFEE45B0DEE640, 0x1D95B0A5FCF90BC6, 0x93CBE0B699C2585D,
+    0x65FA4F227A2B6D79, 0xD5F9E858292504D5, 0xC2B5A03F71471A6F, 0x59300222B4561E00,
+    0xCE2F8642CA0712DC, 0x7CA9723FBB2E8988, 0x2785338347F2BA08, 0xC61BB3A141E50E8C,
+    0x150F361DAB9DEC26, 0x9F6A419D382595F4, 0x64A53DC924FE7AC9, 0x142DE49FFF7A7C3D,
+    0x0C335248857FA9E7, 0x0A9C32D5EAE45305, 0xE6C42178C4BBB92E, 0x71F1CE2490D20B07,
+    0xF1BCC3D275AFE51A, 0xE728E8C83C334074, 0x96FBF83A12884624, 0x81A1549FD6573DA5,
+    0x5FA7867CAF35E149, 0x56986E2EF3ED091B, 0x917F1DD5F8886C61, 0xD20D8C88C8FFE65F,
+    0x31D71DCE64B2C310, 0xF165B587DF898190, 0xA57E6339DD2CF3A0, 0x1EF6E6DBB1961EC9,
+    0x70CC73D90BC26E24, 0xE21A6B35DF0C3AD7, 0x003A93D8B2806962, 0x1C99DED33CB890A1,
+    0xCF3145DE0ADD4289, 0xD0E4427A5514FB72, 0x77C621CC9FB3A483, 0x67A34DAC4356550B,
+    0xF8D626AAAF278509
+};
+
+// Polyglot hash key, used to look up positions in the book
+static uint64_t polyglot_key(const Position *pos) {
+    uint64_t key = 0;
+
+    // Pieces are ordered pawn, knight, bishop, rook, queen, king (ours start at knight), and each
+    // has 2 kinds: black, then white
+    for (bitboard_t b = pos_pieces(pos); b;) {
+        const int square = bb_pop_lsb(&b), piece = (pos_piece_on(pos, square) + 1) % NB_PIECE;
+        const int kind = 2 * piece + (pos_color_on(pos, square) == WHITE);
+        key ^= Random64[64 * kind + square];
+    }
+
+    // Castling rights: white short, white long, black short, black long
+    for (bitboard_t b = pos->castleRooks; b;) {
+        const int rook = bb_pop_lsb(&b), color = pos_color_on(pos, rook);
+        const bool queenSide = file_of(rook) < file_of(pos_king_square(pos, color));
+        key ^= Random64[768 + 2 * color + queenSide];
+    }
+
+    // En passant file, only if a pawn can capture (even if the capture is illegal)
+    if (pos->epSquare != NB_SQUARE && (PawnAttacks[opposite(pos->turn)][pos->epSquare] &
+                                       pos_pieces_cp(pos, pos->turn, PAWN)))
+        key ^= Random64[772 + file_of(pos->epSquare)];
+
+    return pos->turn == WHITE ? key ^ Random64[780] : key;
+}
+
+#ifndef NDEBUG
+// Start position key, from the Polyglot book format specification
+static bool polyglot_key_ok(void) {
+    Position pos;
+    return pos_set(&pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false) &&
+           polyglot_key(&pos) == 0x463B96181691FC9C;
+}
+#endif
+
+// Polyglot move encoding: to (6 bits), from (6 bits), promotion (3 bits: none, N, B, R, Q).
+// Castling is encoded as king captures rook, like our move_t.
+static move_t polyglot_move(uint64_t m) {
+    const int prom = (int)(m >> 12) & 7;
+    return move_build((int)(m >> 6) & 63, (int)m & 63, prom ? KNIGHT + prom - 1 : NB_PIECE);
+}
+
+static uint64_t polyglot_encode(move_t m) {
+    const int prom = move_prom(m);
+    return (uint64_t)move_to(m) | (uint64_t)move_from(m) << 6 |
+           (uint64_t)(prom < NB_PIECE ? prom - KNIGHT + 1 : 0) << 12;
+}
+
+// Play weighted random book moves, until the book has no move, or o->plies is reached. Random
+// choices depend only on the seed and the opening number, so games can be replayed identically.
+static void play_book(const Openings *o, Position **vecPos, size_t idx) {
+    assert(polyglot_key_ok());
+    const size_t entries = o->polyglotSize / POLYGLOT_ENTRY;
+    uint64_t seed = o->seed + idx;
+    move_t *vecMoves = vec_init(move_t);
+    BookMove *vecCandidates = vec_init(BookMove);
+
+    while (!o->plies || vec_size(*vecPos) <= (size_t)o->plies) {
+        const Position *last = &(*vecPos)[vec_size(*vecPos) - 1];
+        const uint64_t key = polyglot_key(last);
+
+        // Binary search for the first entry of 'key'
+        size_t lo = 0, hi = entries;
+
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+
+            if (read_be(o->polyglot + mid * POLYGLOT_ENTRY, 8) < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        // Collect legal moves of the entries (protects against key collisions and corrupt books)
+        vecMoves = gen_all_moves(last, vecMoves);
+        vec_clear(vecCandidates);
+        uint64_t total = 0;
+
+        for (const char *e = o->polyglot + lo * POLYGLOT_ENTRY;
+             e < o->polyglot + o->polyglotSize && read_be(e, 8) == key; e += POLYGLOT_ENTRY) {
+            const BookMove bm = {.key = key,
+                                 .move = polyglot_move(read_be(e + 8, 2)),
+                                 .weight = (uint16_t)read_be(e + 10, 2)};
+
+            for (size_t i = 0; i < vec_size(vecMoves); i++)
+                if (vecMoves[i] == bm.move && bm.weight) {
+                    vec_push(vecCandidates, bm);
+                    total += bm.weight;
+                    break;
+                }
+        }
+
+        if (!total)
+            break;
+
+        // Choose a move with probability proportional to its weight
+        uint64_t pick = prng(&seed) % total;
+        size_t i = 0;
+
+        while (pick >= vecCandidates[i].weight)
+            pick -= vecCandidates[i++].weight;
+
+        Position next;
+        pos_move(&next, last, vecCandidates[i].move);
+        vec_push(*vecPos, next);
+    }
+
+    vec_destroy(vecCandidates);
+    vec_destroy(vecMoves);
+}
+
+bool openings_next(const Openings *o, Position **vecPos, str_t *fen, size_t idx) {
+    if (!read_opening(o, vecPos, fen, idx))
+        return false;
+
+    if (o->polyglot)
+        play_book(o, vecPos, idx);
+
+    return true;
+}
+
+void openings_convert(const char *epdName, const char *bookName) {
+    Openings o = openings_init(epdName, "", ORDER_SEQUENTIAL, 0, false, 0);
+
+    if (o.book)
+        DIE("'%s' is already a book\n", epdName);
+
+    scope(file_close) FILE *out = NULL;
+    DIE_IF(!(out = fopen(bookName, "w" FOPEN_BINARY)));
+
+    BookHeader header = {.count = 0};
+    memcpy(header.magic, BookMagic, sizeof(BookMagic));
+    DIE_IF(fwrite(&header, sizeof(header), 1, out) != 1);
+
+    scope(str_destroy) str_t fen = str_init();
+    Position *vecPos = vec_init(Position);
+
+    for (size_t i = 0; i < o.lines; i++) {
+        if (!openings_next(&o, &vecPos, &fen, i)) {
+            if (fen.len)
+                fprintf(stderr, "Illegal FEN '%s'\n", fen.buf);
+
+            continue;
+        }
+
+        PackedPos pp = {0};
+        pos_pack(&vecPos[0], &pp);
+
+        BookRecord r = {.chess960 = vecPos[0].chess960, .fullMove = vecPos[0].fullMove};
+        memcpy(r.packed, &pp, PACKED_SIZE);
+        DIE_IF(fwrite(&r, sizeof(r), 1, out) != 1);
+        header.count++;
+    }
+
+    // Now that the number of records is known
+    DIE_IF(fseek(out, 0, SEEK_SET) < 0);
+    DIE_IF(fwrite(&header, sizeof(header), 1, out) != 1);
+
+    vec_destroy(vecPos);
+    printf("%" PRIu64 " positions written to '%s'\n", header.count, bookName);
+    openings_destroy(&o);
+}
+
+static int book_move_cmp(const void *a, const void *b) {
+    const BookMove *x = a, *y = b;
+    return x->key != y->key ? (x->key < y->key ? -1 : 1) : (int)x->move - (int)y->move;
+}
+
+void openings_polyglot(const char *pgnName, const char *bookName, int plies) {
+    Openings o = openings_init(pgnName, "", ORDER_SEQUENTIAL, 0, true, plies);
+    scope(str_destroy) str_t fen = str_init();
+    Position *vecPos = vec_init(Position);
+    BookMove *vecBookMoves = vec_init(BookMove);
+
+    // Collect all (position, move) of the games
+    for (size_t i = 0; i < o.lines; i++) {
+        if (!openings_next(&o, &vecPos, &fen, i)) {
+            fprintf(stderr, "Illegal opening '%s'\n", fen.buf);
+            continue;
+        }
+
+        for (size_t ply = 1; ply < vec_size(vecPos); ply++)
+            vec_push(vecBookMoves, ((BookMove){.key = polyglot_key(&vecPos[ply - 1]),
+                                               .move = vecPos[ply].lastMove}));
+    }
+
+    // Sort them, and merge duplicates: the weight of a move is the number of games that played it
+    qsort(vecBookMoves, vec_size(vecBookMoves), sizeof(BookMove), book_move_cmp);
+
+    scope(file_close) FILE *out = NULL;
+    DIE_IF(!(out = fopen(bookName, "w" FOPEN_BINARY)));
+    size_t entries = 0;
+
+    for (size_t i = 0, j = 0; i < vec_size(vecBookMoves); i = j) {
+        while (j < vec_size(vecBookMoves) && !book_move_cmp(&vecBookMoves[i], &vecBookMoves[j]))
+            j++;
+
+        char e[POLYGLOT_ENTRY] = {0};
+        write_be(e, vecBookMoves[i].key, 8);
+        write_be(e + 8, polyglot_encode(vecBookMoves[i].move), 2);
+        write_be(e + 10, min(j - i, (size_t)UINT16_MAX), 2);
+        DIE_IF(fwrite(e, sizeof(e), 1, out) != 1);
+        entries++;
+    }
 
-    str_tok(line.buf, fen, ";");
+    printf("%zu entries written to '%s'\n", entries, bookName);
+    vec_destroy(vecBookMoves);
+    vec_destroy(vecPos);
+    openings_destroy(&o);
 }
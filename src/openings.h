@@ -13,19 +13,50 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include "position.h"
 #include "str.h"
 #include <inttypes.h>
-#include <pthread.h>
 #include <stdbool.h>
-#include <stdio.h>
 
+// Openings are records of a file: lines of an EPD file, games of a PGN file (whose moves are played
+// from their starting position), or positions of a binary book (see openings_convert()), which are
+// fixed size and already validated. A Polyglot book can be used in addition, to play weighted
+// random book moves from each opening.
+//
+// Order in which openings are used. Sequential and random orders index every record of the file,
+// while streaming orders only index the first record of each block of OPENINGS_BLOCK records, which
+// reduces memory usage accordingly, at the cost of scanning the block in openings_next(). In random
+// order all records are shuffled, whereas in stream-shuffle order, blocks are shuffled, and records
+// within each block. In all cases, each opening is used once per cycle through the file.
+enum { ORDER_SEQUENTIAL, ORDER_RANDOM, ORDER_STREAM, ORDER_STREAM_SHUFFLE };
+enum { OPENINGS_BLOCK = 1024 };
+
+// Openings file, mapped in memory. Read only after openings_init(), so it is thread safe without
+// any locking.
 typedef struct {
-    pthread_mutex_t mtx;
-    FILE *file;
-    long *vecIndex; // vector of file offsets
+    const char *map;      // file content
+    const char *polyglot; // Polyglot book content (if any)
+    size_t size, polyglotSize;
+    size_t *vecIndex; // vector of record offsets (first record of each block, in streaming orders)
+    size_t lines;     // number of records
+    uint64_t seed;    // permutation of records within blocks (stream-shuffle), book move choices
+    int order;
+    int plies; // maximum number of plies of the opening, PGN and book moves (0 = no limit)
+    bool book; // binary book
+    bool pgn;  // PGN file
 } Openings;
 
-Openings openings_init(const char *fileName, bool random, uint64_t srand);
+Openings openings_init(const char *fileName, const char *bookName, int order, uint64_t srand,
+                       bool pgn, int plies);
 void openings_destroy(Openings *openings);
 
-void openings_next(Openings *o, str_t *fen, size_t idx);
+// Set *vecPos to opening number 'idx': its starting position, followed by the position after each
+// move (PGN moves, then book moves). Returns false if the opening is illegal (described in 'fen',
+// except for books).
+bool openings_next(const Openings *o, Position **vecPos, str_t *fen, size_t idx);
+
+// Convert EPD file to binary book. Illegal positions are skipped.
+void openings_convert(const char *epdName, const char *bookName);
+
+// Create Polyglot book from the first 'plies' plies of each game in a PGN file (0 = all)
+void openings_polyglot(const char *pgnName, const char *bookName, int plies);
@@ -30,14 +30,17 @@ static int options_parse_sample(int argc, const char **argv, int i, Options *o)
             o->sp.decay = atof(tail);
         else if ((tail = str_prefix(argv[i], "resolve=")))
             o->sp.resolve = (*tail == 'y');
+        else if ((tail = str_prefix(argv[i], "dedup=")))
+            o->sp.dedup = (size_t)atoll(tail) << 20;
+        else if ((tail = str_prefix(argv[i], "shard=")))
+            o->sp.shard = (*tail == 'y');
         else if ((tail = str_prefix(argv[i], "file=")))
             str_cpy_c(&o->sp.fileName, tail);
         else if ((tail = str_prefix(argv[i], "format="))) {
-            if (!strcmp(tail, "csv"))
-                o->sp.bin = false;
-            else if (!strcmp(tail, "bin"))
-                o->sp.bin = true;
-            else
+            o->sp.bin = !strcmp(tail, "bin") || !strcmp(tail, "bin2");
+            o->sp.blocks = !strcmp(tail, "bin2");
+
+            if (!o->sp.bin && strcmp(tail, "csv"))
                 DIE("Illegal format in -sample: '%s'\n", tail);
         } else
             DIE("Illegal token in -sample: '%s'\n", argv[i]);
@@ -113,10 +116,23 @@ static int options_parse_openings(int argc, const char **argv, int i, Options *o
             str_cpy_c(&o->openings, tail);
         else if ((tail = str_prefix(argv[i], "order="))) {
             if (!strcmp(tail, "random"))
-                o->random = true;
+                o->order = ORDER_RANDOM;
+            else if (!strcmp(tail, "stream"))
+                o->order = ORDER_STREAM;
+            else if (!strcmp(tail, "stream-shuffle"))
+                o->order = ORDER_STREAM_SHUFFLE;
             else if (strcmp(tail, "sequential"))
                 DIE("Invalid order for -openings: '%s'\n", tail);
-        } else if ((tail = str_prefix(argv[i], "srand=")))
+        } else if ((tail = str_prefix(argv[i], "format="))) {
+            if (!strcmp(tail, "pgn"))
+                o->openingsPgn = true;
+            else if (strcmp(tail, "epd"))
+                DIE("Invalid format for -openings: '%s'\n", tail);
+        } else if ((tail = str_prefix(argv[i], "book=")))
+            str_cpy_c(&o->book, tail);
+        else if ((tail = str_prefix(argv[i], "plies=")))
+            o->plies = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "srand=")))
             o->srand = (uint64_t)atoll(tail);
         else
             DIE("Illegal token in -openings: '%s'\n", argv[i]);
@@ -163,7 +179,12 @@ static int options_parse_sprt(int argc, const char **argv, int i, Options *o) {
             o->sprtParam.alpha = atof(tail);
         else if ((tail = str_prefix(argv[i], "beta=")))
             o->sprtParam.beta = atof(tail);
-        else
+        else if ((tail = str_prefix(argv[i], "model="))) {
+            if (!strcmp(tail, "pentanomial"))
+                o->sprtParam.pentanomial = true;
+            else if (strcmp(tail, "trinomial"))
+                DIE("Illegal SPRT model: '%s'\n", tail);
+        } else
             DIE("Illegal token in -sprt: '%s'\n", argv[i]);
 
         i++;
@@ -224,17 +245,24 @@ void sample_params_destroy(SampleParams *sp) { str_destroy(&sp->fileName); }
 Options options_init(void) {
     return (Options){.sp = sample_params_init(),
                      .openings = str_init(),
+                     .book = str_init(),
                      .pgn = str_init(),
+                     .checkpoint = str_init(),
+                     .resume = str_init(),
                      .concurrency = 1,
                      .games = 1,
                      .rounds = 1,
                      .sprtParam = (SPRTParam){.alpha = 0.05, .beta = 0.05, .elo1 = 4},
-                     .pgnVerbosity = 3};
+                     .pgnVerbosity = 3,
+                     .checkpointInterval = 60,
+                     .flushMsec = 1000,
+                     .flushBytes = 1 << 20,
+                     .maxQueued = 1 << 26};
 }
 
 void options_destroy(Options *o) {
     sample_params_destroy(&o->sp);
-    str_destroy_n(&o->openings, &o->pgn);
+    str_destroy_n(&o->openings, &o->book, &o->pgn, &o->checkpoint, &o->resume);
 }
 
 EngineOptions *options_parse(int argc, const char **argv, Options *o) {
@@ -249,10 +277,20 @@ EngineOptions *options_parse(int argc, const char **argv, Options *o) {
             o->gauntlet = true;
         else if (!strcmp(argv[i], "-log"))
             o->log = true;
+        else if (!strcmp(argv[i], "-affinity"))
+            o->affinity = true;
         else if (!strcmp(argv[i], "-concurrency")) {
             o->concurrency = atoi(argv[++i]);
             if (o->concurrency < 1)
                 DIE("Invalid value for -concurrency: '%s'\n", argv[i]);
+        } else if (!strcmp(argv[i], "-iothreads")) {
+            o->ioThreads = atoi(argv[++i]);
+            if (o->ioThreads < 1)
+                DIE("Invalid value for -iothreads: '%s'\n", argv[i]);
+        } else if (!strcmp(argv[i], "-enginepool")) {
+            o->enginePool = atoi(argv[++i]);
+            if (o->enginePool < 0)
+                DIE("Invalid value for -enginepool: '%s'\n", argv[i]);
         } else if (!strcmp(argv[i], "-each")) {
             i = options_parse_eo(argc, argv, i + 1, &each);
             eachSet = true;
@@ -271,7 +309,27 @@ EngineOptions *options_parse(int argc, const char **argv, Options *o) {
 
             if (i + 1 < argc && argv[i + 1][0] != '-')
                 o->pgnVerbosity = atoi(argv[++i]);
-        } else if (!strcmp(argv[i], "-resign"))
+        } else if (!strcmp(argv[i], "-flush")) {
+            o->flushMsec = atoll(argv[++i]);
+
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                o->flushBytes = (size_t)atoll(argv[++i]);
+
+            if (o->flushMsec < 1 || !o->flushBytes)
+                DIE("Invalid value for -flush\n");
+        } else if (!strcmp(argv[i], "-queue"))
+            o->maxQueued = (size_t)atoll(argv[++i]);
+        else if (!strcmp(argv[i], "-checkpoint")) {
+            str_cpy_c(&o->checkpoint, argv[++i]);
+
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                o->checkpointInterval = atoi(argv[++i]);
+                if (o->checkpointInterval < 1)
+                    DIE("Invalid value for -checkpoint: '%s'\n", argv[i]);
+            }
+        } else if (!strcmp(argv[i], "-resume"))
+            str_cpy_c(&o->resume, argv[++i]);
+        else if (!strcmp(argv[i], "-resign"))
             i = options_parse_adjudication(argc, argv, i + 1, &o->resignNumber, &o->resignCount,
                                            &o->resignScore);
         else if (!strcmp(argv[i], "-draw"))
@@ -293,8 +351,19 @@ EngineOptions *options_parse(int argc, const char **argv, Options *o) {
     if (vec_size(vecEO) < 2)
         DIE("at least 2 engines are needed\n");
 
+    // Resuming a tournament keeps checkpointing it, by default in the same file
+    if (o->resume.len && !o->checkpoint.len)
+        str_cpy(&o->checkpoint, o->resume);
+
+    // No point in having more event loops than workers to run
+    o->ioThreads = min(o->ioThreads, o->concurrency);
+
     if (vec_size(vecEO) > 2 && o->sprt)
         DIE("only 2 engines for SPRT\n");
 
+    // Game pairs are games 2k and 2k+1, which must share the opening, and belong to the same pair
+    if (o->sprt && o->sprtParam.pentanomial && (!o->repeat || o->games % 2))
+        DIE("pentanomial SPRT requires -repeat, and an even number of -games\n");
+
     return vecEO;
 }
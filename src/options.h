@@ -13,6 +13,7 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include "openings.h"
 #include "sprt.h"
 #include "str.h"
 #include "workers.h"
@@ -21,19 +22,22 @@
 typedef struct {
     str_t fileName;
     double freq, decay;
-    bool resolve, bin;
+    size_t dedup; // memory budget for duplicate detection, in bytes (0 to disable)
+    bool resolve, bin, blocks, shard;
 } SampleParams;
 
 typedef struct {
     SampleParams sp;
-    str_t openings, pgn;
+    str_t openings, book, pgn, checkpoint, resume;
     SPRTParam sprtParam;
     uint64_t srand;
-    int concurrency, games, rounds;
+    int64_t flushMsec;
+    size_t flushBytes, maxQueued;
+    int concurrency, ioThreads, enginePool, games, rounds;
     int resignNumber, resignCount, resignScore;
     int drawNumber, drawCount, drawScore;
-    int pgnVerbosity;
-    bool log, random, repeat, sprt, gauntlet;
+    int pgnVerbosity, checkpointInterval, order, plies;
+    bool log, repeat, openingsPgn, sprt, gauntlet, affinity;
 } Options;
 
 typedef struct {
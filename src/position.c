@@ -724,3 +724,34 @@ size_t pos_pack(const Position *pos, PackedPos *pp) {
 
     return offsetof(PackedPos, packedPieces) + (nibbleIdx + 1) / 2;
 }
+
+// Inverse of pos_pack(). Note that chess960 and fullMove are not encoded, and set to false and 1.
+void pos_unpack(Position *pos, const PackedPos *pp) {
+    *pos = (Position){.turn = pp->turn, .rule50 = pp->rule50, .fullMove = 1, .epSquare = NB_SQUARE};
+
+    if (pos->turn == BLACK)
+        pos->key ^= ZobristTurn;
+
+    bitboard_t remaining = pp->occ;
+    unsigned nibbleIdx = 0;
+
+    while (remaining) {
+        const int square = bb_pop_lsb(&remaining);
+        const int nibble = (pp->packedPieces[nibbleIdx / 2] >> (nibbleIdx % 2 ? 4 : 0)) & 15;
+        const int color = nibble & 1, extPiece = nibble / 2;
+        nibbleIdx++;
+
+        if (extPiece == PAWN + 1) {
+            set_square(pos, color, ROOK, square);
+            bb_set(&pos->castleRooks, square);
+        } else if (extPiece == PAWN + 2) {
+            set_square(pos, color, PAWN, square);
+            pos->epSquare = (uint8_t)(square + push_inc(pos->turn));
+        } else
+            set_square(pos, color, extPiece, square);
+    }
+
+    pos->key ^= zobrist_castling(pos->castleRooks);
+    pos->key ^= ZobristEnPassant[pos->epSquare];
+    finish(pos);
+}
@@ -61,3 +61,4 @@ move_t pos_lan_to_move(const Position *pos, const char *lan);
 void pos_print(const Position *pos);
 
 size_t pos_pack(const Position *pos, PackedPos *pp);
+void pos_unpack(Position *pos, const PackedPos *pp);
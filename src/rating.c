@@ -0,0 +1,225 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rating.h"
+#include "util.h"
+#include "vec.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Prior: each engine is given PRIOR_DRAWS virtual draws against a virtual engine of strength 1.
+// This keeps ratings finite (eg. an engine that won all its games), and anchors the scale.
+static const double PRIOR_DRAWS = 2;
+
+static const double EPSILON = 1e-6; // convergence criterion, on log(gamma)
+static const int UPDATE_ITERATIONS = 4, MAX_ITERATIONS = 10000;
+
+Ratings ratings_init(int engines) {
+    const size_t n = (size_t)engines;
+    Ratings r = {.vecGamma = vec_init_reserve(n, double),
+                 .vecPoints = vec_init_reserve(n * n, double),
+                 .vecGames = vec_init_reserve(n * n, int),
+                 .n = engines};
+
+    for (size_t i = 0; i < n; i++)
+        vec_push(r.vecGamma, 1.0);
+
+    for (size_t i = 0; i < n * n; i++) {
+        vec_push(r.vecPoints, 0.0);
+        vec_push(r.vecGames, 0);
+    }
+
+    return r;
+}
+
+void ratings_destroy(Ratings *r) {
+    vec_destroy(r->vecGamma);
+    vec_destroy(r->vecPoints);
+    vec_destroy(r->vecGames);
+}
+
+void ratings_add(Ratings *r, int a, int b, double points, int games) {
+    assert(0 <= a && a < r->n && 0 <= b && b < r->n && a != b);
+
+    r->vecPoints[a * r->n + b] += points;
+    r->vecPoints[b * r->n + a] += games - points;
+    r->vecGames[a * r->n + b] += games;
+    r->vecGames[b * r->n + a] += games;
+}
+
+// One iteration of the MM algorithm (Hunter 2004), with in place (Gauss-Seidel) updates:
+// gamma[i] = points[i] / sum(games[i][j] / (gamma[i] + gamma[j])). Returns true if converged.
+static bool ratings_iterate(Ratings *r) {
+    double maxDelta = 0;
+
+    for (int i = 0; i < r->n; i++) {
+        const double *points = &r->vecPoints[i * r->n];
+        const int *games = &r->vecGames[i * r->n];
+        double sumPoints = PRIOR_DRAWS / 2, denominator = PRIOR_DRAWS / (r->vecGamma[i] + 1);
+
+        for (int j = 0; j < r->n; j++)
+            if (games[j]) {
+                sumPoints += points[j];
+                denominator += games[j] / (r->vecGamma[i] + r->vecGamma[j]);
+            }
+
+        const double gamma = sumPoints / denominator;
+        maxDelta = max(maxDelta, fabs(log(gamma / r->vecGamma[i])));
+        r->vecGamma[i] = gamma;
+    }
+
+    return maxDelta < EPSILON;
+}
+
+void ratings_update(Ratings *r) {
+    for (int iteration = 0; iteration < UPDATE_ITERATIONS && !ratings_iterate(r); iteration++)
+        ;
+}
+
+void ratings_solve(Ratings *r) {
+    for (int iteration = 0; iteration < MAX_ITERATIONS && !ratings_iterate(r); iteration++)
+        ;
+}
+
+// Invert symmetric positive definite matrix a[n*n] in place, using Cholesky decomposition
+static void invert_spd(double *a, int n) {
+    // a = L.L^T, with L stored in the lower triangle of a
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < j; k++)
+            a[j * n + j] -= a[j * n + k] * a[j * n + k];
+
+        a[j * n + j] = sqrt(a[j * n + j]);
+
+        for (int i = j + 1; i < n; i++) {
+            for (int k = 0; k < j; k++)
+                a[i * n + j] -= a[i * n + k] * a[j * n + k];
+
+            a[i * n + j] /= a[j * n + j];
+        }
+    }
+
+    // L^-1, in the lower triangle of a
+    for (int j = 0; j < n; j++) {
+        a[j * n + j] = 1 / a[j * n + j];
+
+        for (int i = j + 1; i < n; i++) {
+            double sum = 0;
+
+            for (int k = j; k < i; k++)
+                sum -= a[i * n + k] * a[k * n + j];
+
+            a[i * n + j] = sum / a[i * n + i];
+        }
+    }
+
+    // a^-1 = L^-T.L^-1 (symmetric: compute the lower triangle, and copy to the upper one)
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j <= i; j++) {
+            double sum = 0;
+
+            for (int k = i; k < n; k++)
+                sum += a[k * n + i] * a[k * n + j];
+
+            a[i * n + j] = sum;
+        }
+
+    for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+            a[i * n + j] = a[j * n + i];
+}
+
+void ratings_print(const Ratings *r, const str_t *vecNames, str_t *out) {
+    const size_t n = (size_t)r->n;
+    const double eloPerUnit = 400 / log(10);
+
+    // Fisher information matrix, with respect to log(gamma), including the prior. Its inverse is
+    // the covariance matrix of the maximum likelihood estimator.
+    double *cov = calloc(n * n, sizeof(double));
+
+    for (size_t i = 0; i < n; i++) {
+        const double gi = r->vecGamma[i];
+        cov[i * n + i] += PRIOR_DRAWS * gi / ((gi + 1) * (gi + 1));
+
+        for (size_t j = 0; j < i; j++) {
+            const double gj = r->vecGamma[j];
+            const double v = r->vecGames[i * n + j] * gi * gj / ((gi + gj) * (gi + gj));
+            cov[i * n + i] += v;
+            cov[j * n + j] += v;
+            cov[i * n + j] -= v;
+            cov[j * n + i] -= v;
+        }
+    }
+
+    invert_spd(cov, r->n);
+
+    // Elo relative to the average engine: elo[i] = c * (theta[i] - mean(theta)), so its variance is
+    // c^2 * (cov[i][i] - 2 * mean(cov[i][]) + mean(cov[][]))
+    double meanTheta = 0, meanCov = 0;
+    double *meanRow = calloc(n, sizeof(double));
+
+    for (size_t i = 0; i < n; i++) {
+        meanTheta += log(r->vecGamma[i]) / n;
+
+        for (size_t j = 0; j < n; j++) {
+            meanRow[i] += cov[i * n + j] / n;
+            meanCov += cov[i * n + j] / (n * n);
+        }
+    }
+
+    // Rank engines by strength (insertion sort)
+    size_t *rank = calloc(n, sizeof(size_t));
+
+    for (size_t i = 0; i < n; i++) {
+        size_t j = i;
+
+        for (; j > 0 && r->vecGamma[rank[j - 1]] < r->vecGamma[i]; j--)
+            rank[j] = rank[j - 1];
+
+        rank[j] = i;
+    }
+
+    char line[128] = "";
+    snprintf(line, sizeof(line), "%4s %-28s %6s %6s %7s %7s\n", "Rank", "Name", "Elo", "+/-",
+             "Games", "Score");
+    str_cat_c(out, line);
+    size_t printed = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        const size_t i = rank[k];
+        const double elo = eloPerUnit * (log(r->vecGamma[i]) - meanTheta);
+        const double error =
+            1.96 * eloPerUnit * sqrt(max(cov[i * n + i] - 2 * meanRow[i] + meanCov, 0.0));
+
+        int games = 0;
+        double points = 0;
+
+        for (size_t j = 0; j < n; j++) {
+            games += r->vecGames[i * n + j];
+            points += r->vecPoints[i * n + j];
+        }
+
+        if (!games)
+            continue;
+
+        snprintf(line, sizeof(line), "%4zu %-28s %6ld %6ld %7d %6.1f%%\n", ++printed,
+                 vecNames[i].buf, lround(elo), lround(error), games, 100 * points / games);
+        str_cat_c(out, line);
+    }
+
+    free(rank);
+    free(meanRow);
+    free(cov);
+}
@@ -0,0 +1,43 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "str.h"
+#include <stdbool.h>
+
+// Bradley-Terry model: engine i beats engine j with probability gamma[i] / (gamma[i] + gamma[j]),
+// where draws count as half a win and half a loss. Maximum likelihood estimation by MM iterations,
+// warm started from the previous solution, as games are added one at a time.
+typedef struct {
+    double *vecGamma;  // strength of each engine
+    double *vecPoints; // vecPoints[i * n + j]: points scored by i against j
+    int *vecGames;     // vecGames[i * n + j]: games played between i and j
+    int n;             // number of engines
+} Ratings;
+
+Ratings ratings_init(int engines);
+void ratings_destroy(Ratings *r);
+
+// Record 'games' games between engines a and b, where a scored 'points'
+void ratings_add(Ratings *r, int a, int b, double points, int games);
+
+// Refine the solution after adding a few games: a handful of iterations, warm started from the
+// previous solution, which is cheap enough to run after every game, even with hundreds of engines.
+void ratings_update(Ratings *r);
+
+// Iterate until convergence to the maximum likelihood solution
+void ratings_solve(Ratings *r);
+
+// Append a table of engines ranked by Elo, with 95% confidence error bars
+void ratings_print(const Ratings *r, const str_t *vecNames, str_t *out);
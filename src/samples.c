@@ -0,0 +1,198 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "samples.h"
+#include "bitboard.h"
+#include "gzip.h"
+#include "vec.h"
+#include <string.h>
+
+#ifdef __BMI2__
+    #include <immintrin.h>
+#endif
+
+const char SampleMagic[8] = "CCCSMPL2";
+
+static uint32_t get_u32(const char *p) {
+    return (uint32_t)(uint8_t)p[0] | (uint32_t)(uint8_t)p[1] << 8 | (uint32_t)(uint8_t)p[2] << 16 |
+           (uint32_t)(uint8_t)p[3] << 24;
+}
+
+static void set_u32(char *p, uint32_t u) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (char)(u >> (8 * i));
+}
+
+size_t sample_record_size(const char *record) {
+    uint64_t occ = 0;
+    memcpy(&occ, record, sizeof(occ));
+    return 9 + ((size_t)bb_count(occ) + 1) / 2 + 2 + 1;
+}
+
+void samples_pack(char **vecRecords, char **vecOut, bool final) {
+    const size_t size = vec_size(*vecRecords);
+    size_t done = 0;
+
+    while (done < size) {
+        // Take as many records as fit in the block
+        size_t end = done, used = SAMPLE_BLOCK_HEADER;
+        uint32_t count = 0;
+
+        while (end < size) {
+            const size_t bytes = sample_record_size(&(*vecRecords)[end]);
+
+            if (used + 2 + bytes > SAMPLE_BLOCK_SIZE)
+                break;
+
+            used += 2 + bytes;
+            end += bytes;
+            count++;
+        }
+
+        assert(end <= size);
+
+        if (end == size && !final)
+            break; // block is not full: wait for more records
+
+        // Header, offsets, records, and zero padding
+        const size_t start = vec_size(*vecOut);
+        *vecOut = vec_do_grow(*vecOut, 1, SAMPLE_BLOCK_SIZE);
+        vec_ptr(*vecOut)->size += SAMPLE_BLOCK_SIZE;
+
+        char *block = &(*vecOut)[start];
+        memset(block, 0, SAMPLE_BLOCK_SIZE);
+        memcpy(block, SampleMagic, sizeof(SampleMagic));
+        set_u32(&block[12], SAMPLE_BLOCK_SIZE);
+        set_u32(&block[16], count);
+
+        size_t offset = SAMPLE_BLOCK_HEADER + 2 * count;
+        memcpy(&block[offset], &(*vecRecords)[done], end - done);
+
+        for (uint32_t i = 0; i < count; i++) {
+            block[SAMPLE_BLOCK_HEADER + 2 * i] = (char)offset;
+            block[SAMPLE_BLOCK_HEADER + 2 * i + 1] = (char)(offset >> 8);
+            offset += sample_record_size(&block[offset]);
+        }
+
+        set_u32(&block[8], gzip_crc32(0, &block[12], SAMPLE_BLOCK_SIZE - 12));
+        done = end;
+    }
+
+    // Remove packed records
+    memmove(*vecRecords, &(*vecRecords)[done], size - done);
+    vec_ptr(*vecRecords)->size = size - done;
+}
+
+int sample_block_check(const char *block) {
+    if (memcmp(block, SampleMagic, sizeof(SampleMagic)) ||
+        get_u32(&block[12]) != SAMPLE_BLOCK_SIZE ||
+        get_u32(&block[8]) != gzip_crc32(0, &block[12], SAMPLE_BLOCK_SIZE - 12))
+        return -1;
+
+    const uint32_t count = get_u32(&block[16]);
+    return SAMPLE_BLOCK_HEADER + 2 * (size_t)count <= SAMPLE_BLOCK_SIZE ? (int)count : -1;
+}
+
+// Fields of a record, other than the planes. Note that turn is the low bit of the byte following
+// occ in PackedPos.
+static size_t unpack_fields(const char *rec, size_t i, const SampleBatch *b) {
+    const size_t bytes = sample_record_size(rec);
+    b->turns[i] = (uint8_t)rec[8] & 1;
+    b->scores[i] = (int16_t)((uint8_t)rec[bytes - 3] | (uint8_t)rec[bytes - 2] << 8);
+    b->results[i] = (uint8_t)rec[bytes - 1];
+    return bytes;
+}
+
+size_t samples_unpack_scalar(const char *buf, size_t n, const SampleBatch *b) {
+    size_t offset = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const char *rec = &buf[offset];
+        bitboard_t occ = 0, planes[NB_COLOR * NB_PIECE] = {0};
+        memcpy(&occ, rec, sizeof(occ));
+
+        // Castling rooks and en-passant pawns have their own codes (see pos_pack())
+        for (int k = 0; occ; k++) {
+            const int square = bb_pop_lsb(&occ);
+            const int nibble = ((uint8_t)rec[9 + k / 2] >> (k % 2 ? 4 : 0)) & 15;
+            const int extPiece = nibble / 2;
+            const int piece = extPiece == PAWN + 1 ? ROOK : extPiece == PAWN + 2 ? PAWN : extPiece;
+            bb_set(&planes[NB_PIECE * (nibble & 1) + piece], square);
+        }
+
+        for (int p = 0; p < NB_COLOR * NB_PIECE; p++)
+            b->planes[(size_t)p * n + i] = planes[p];
+
+        offset += unpack_fields(rec, i, b);
+    }
+
+    return offset;
+}
+
+#ifdef __BMI2__
+// For each nibble value v, the mask of nibbles equal to v (SIMD compares), is the mask of pieces of
+// that kind, in the order of the bits of occ: pdep() deposits it on occ.
+size_t samples_unpack(const char *buf, size_t n, const SampleBatch *b) {
+    const __m128i low = _mm_set1_epi8(15);
+    size_t offset = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const char *rec = &buf[offset];
+        bitboard_t occ = 0;
+        memcpy(&occ, rec, sizeof(occ));
+
+        // Load 16 bytes of nibbles. Nibbles beyond the pieces of occ are ignored by pdep(), so it
+        // is fine to read into the next record, which is at least 12 bytes (with 2 kings, this
+        // record has at least 13 bytes). But not beyond the last record of buf.
+        char packed[16] = {0};
+
+        if (i + 1 < n)
+            memcpy(packed, &rec[9], sizeof(packed));
+        else
+            memcpy(packed, &rec[9], ((size_t)bb_count(occ) + 1) / 2);
+
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)packed);
+        const __m128i lo = _mm_and_si128(bytes, low);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low);
+        const __m128i first = _mm_unpacklo_epi8(lo, hi), second = _mm_unpackhi_epi8(lo, hi);
+        uint32_t masks[16];
+
+        for (int v = 0; v < 16; v++) {
+            const __m128i value = _mm_set1_epi8((char)v);
+            masks[v] = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(first, value)) |
+                       (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(second, value)) << 16;
+        }
+
+        for (int color = WHITE; color <= BLACK; color++)
+            for (int piece = KNIGHT; piece <= PAWN; piece++) {
+                uint32_t mask = masks[2 * piece + color];
+
+                if (piece == ROOK)
+                    mask |= masks[2 * (PAWN + 1) + color];
+                else if (piece == PAWN)
+                    mask |= masks[2 * (PAWN + 2) + color];
+
+                b->planes[(size_t)(NB_PIECE * color + piece) * n + i] = _pdep_u64(mask, occ);
+            }
+
+        offset += unpack_fields(rec, i, b);
+    }
+
+    return offset;
+}
+#else
+size_t samples_unpack(const char *buf, size_t n, const SampleBatch *b) {
+    return samples_unpack_scalar(buf, n, b);
+}
+#endif
@@ -0,0 +1,59 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "bitboard.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary sample records (format=bin): PackedPos (see pos_pack()), int16_t score, uint8_t result.
+// Their size is given by the number of pieces, ie. popcount(PackedPos.occ).
+enum { SAMPLE_RECORD_MAX = 9 + 16 + 2 + 1 };
+
+size_t sample_record_size(const char *record);
+
+// Block structured format (format=bin2), made of fixed size blocks, so that files can be split
+// across threads without scanning them. There is no separate file header: each block starts with
+// one, so that files (eg. shards) can simply be concatenated.
+//   char magic[8];        // "CCCSMPL2": format and version
+//   uint32_t crc;         // CRC-32 of the rest of the block (from blockSize to the end)
+//   uint32_t blockSize;   // SAMPLE_BLOCK_SIZE
+//   uint32_t count;       // number of records in the block
+//   uint32_t reserved;    // zero
+//   uint16_t offsets[count]; // position of each record, from the start of the block
+//   records, followed by zero padding up to blockSize
+// All integers are little endian.
+enum { SAMPLE_BLOCK_SIZE = 1 << 16, SAMPLE_BLOCK_HEADER = 24 };
+
+extern const char SampleMagic[8];
+
+// Pack records from *vecRecords into blocks, appended to *vecOut. Records that do not fill a block
+// are left in *vecRecords, unless 'final', in which case they are packed in a last partial block.
+void samples_pack(char **vecRecords, char **vecOut, bool final);
+
+// Check the header and CRC of a block. Returns the number of records, or -1 if invalid.
+int sample_block_check(const char *block);
+
+// Batch of decoded samples, in structure of arrays layout, for n samples
+typedef struct {
+    bitboard_t *planes; // planes[p * n + i]: piece p = NB_PIECE * color + piece, in sample i
+    int16_t *scores;
+    uint8_t *results, *turns;
+} SampleBatch;
+
+// Decode n records from buf into batch b (sized for n samples). Returns the number of bytes read.
+// samples_unpack() uses pdep (BMI2) and SIMD when available, samples_unpack_scalar() never does.
+size_t samples_unpack(const char *buf, size_t n, const SampleBatch *b);
+size_t samples_unpack_scalar(const char *buf, size_t n, const SampleBatch *b);
@@ -13,68 +13,366 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #include "seqwriter.h"
+#include "gzip.h"
+#include "samples.h"
+#include "util.h"
 #include "vec.h"
 #include <string.h>
+#include <time.h>
 
-static SeqStr seq_str_init(size_t idx, str_t str) {
-    return (SeqStr){.idx = idx, .str = str_init_from(str)};
+enum { RING_SIZE = 64 }; // initial size of the ring buffer
+
+Encoder encoder_init(int flags) {
+    return (Encoder){.vecCarry = vec_init(char),
+                     .vecPacked = vec_init(char),
+                     .vecCompressed = vec_init(char),
+                     .flags = flags};
+}
+
+void encoder_destroy(Encoder *e) {
+    vec_destroy(e->vecCarry);
+    vec_destroy(e->vecPacked);
+    vec_destroy(e->vecCompressed);
+}
+
+void encoder_write(Encoder *e, const char *buf, size_t len, bool final, FILE *out) {
+    if (e->flags & ENCODE_BLOCKS) {
+        vec_push_n(e->vecCarry, buf, len);
+        vec_clear(e->vecPacked);
+        samples_pack(&e->vecCarry, &e->vecPacked, final);
+        buf = e->vecPacked;
+        len = vec_size(e->vecPacked);
+    }
+
+    if (len && (e->flags & ENCODE_GZIP)) {
+        vec_clear(e->vecCompressed);
+        gzip_member(buf, len, &e->vecCompressed);
+        buf = e->vecCompressed;
+        len = vec_size(e->vecCompressed);
+    }
+
+    DIE_IF(fwrite(buf, 1, len, out) != len);
+}
+
+void encoder_save(const Encoder *e, FILE *out) {
+    const size_t len = vec_size(e->vecCarry);
+    DIE_IF(fprintf(out, "carry %zu\n", len) < 0);
+    DIE_IF(fwrite(e->vecCarry, 1, len, out) != len);
+}
+
+void encoder_load(Encoder *e, FILE *in) {
+    size_t len = 0;
+
+    if (fscanf(in, " carry %zu", &len) != 1 || fgetc(in) != '\n')
+        DIE("invalid checkpoint\n");
+
+    vec_clear(e->vecCarry);
+    e->vecCarry = vec_do_grow(e->vecCarry, 1, len);
+
+    if (fread(e->vecCarry, 1, len, in) != len)
+        DIE("invalid checkpoint\n");
+
+    vec_ptr(e->vecCarry)->size = len;
+}
+
+static void seq_buf_destroy(SeqBuf *sb) { vec_destroy(sb->vecData); }
+
+static SeqBuf *seq_writer_slot(SeqWriter *sw, size_t idx) {
+    return &sw->vecRing[idx & (vec_size(sw->vecRing) - 1)];
+}
+
+// Grow the ring buffer, so that it can hold idx
+static void seq_writer_grow(SeqWriter *sw, size_t idx) {
+    const size_t size = vec_size(sw->vecRing);
+    size_t newSize = size;
+
+    while (idx - sw->idxNext >= newSize)
+        newSize *= 2;
+
+    SeqBuf *vecRing = vec_init_reserve(newSize, SeqBuf);
+
+    for (size_t i = 0; i < newSize; i++)
+        vec_push(vecRing, (SeqBuf){0});
+
+    for (size_t i = sw->idxNext; i < sw->idxNext + size; i++)
+        vecRing[i & (newSize - 1)] = sw->vecRing[i & (size - 1)];
+
+    vec_destroy(sw->vecRing);
+    sw->vecRing = vecRing;
+}
+
+// Append the data of a queued buffer (in memory or spilled) to *vecOut. Spilled data can be read
+// without the mutex, as other threads only append to the spill file.
+static void seq_writer_read(SeqWriter *sw, const SeqBuf *sb, char **vecOut) {
+    if (!sb->spilled) {
+        vec_push_n(*vecOut, sb->vecData, sb->len);
+        return;
+    }
+
+    *vecOut = vec_do_grow(*vecOut, 1, sb->len);
+    DIE_IF(file_read_at(sw->spill, *vecOut + vec_size(*vecOut), sb->len, sb->offset) < 0);
+    vec_ptr(*vecOut)->size += sb->len;
+}
+
+// Queue buffer idx, in memory, or in the spill file if the memory budget is exhausted
+static void seq_writer_queue(SeqWriter *sw, size_t idx, const char *buf, size_t len) {
+    assert(idx >= sw->idxNext);
+
+    if (idx - sw->idxNext >= vec_size(sw->vecRing))
+        seq_writer_grow(sw, idx);
+
+    SeqBuf *sb = seq_writer_slot(sw, idx);
+    assert(!sb->queued);
+
+    if (sw->queuedBytes + len <= sw->maxQueued) {
+        *sb = (SeqBuf){.vecData = vec_init_reserve(len, char), .len = len, .queued = true};
+        vec_push_n(sb->vecData, buf, len);
+        sw->queuedBytes += len;
+    } else {
+        if (!sw->spill)
+            DIE_IF(!(sw->spill = tmpfile()));
+
+        DIE_IF(fseek(sw->spill, sw->spillEnd, SEEK_SET) < 0);
+        DIE_IF(fwrite(buf, 1, len, sw->spill) != len);
+        DIE_IF(fflush(sw->spill) < 0); // make it visible to file_read_at()
+
+        *sb = (SeqBuf){.offset = sw->spillEnd, .len = len, .queued = true, .spilled = true};
+        sw->spillEnd += (long)len;
+        sw->spilledCount++;
+    }
+}
+
+// Writer thread: waits until enough data is ready to be written (or flushMsec have elapsed), and
+// writes it all at once (encoded, if needed), without holding the mutex, so that producers never
+// wait for the disk.
+static void *seq_writer_thread(void *arg) {
+    SeqWriter *sw = arg;
+    char *vecBatch = vec_init(char);
+    Encoder *e = &sw->encoder;
+
+    pthread_mutex_lock(&sw->mtx);
+
+    while (true) {
+        struct timespec deadline = {0};
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += sw->flushMsec / 1000;
+        deadline.tv_nsec += (sw->flushMsec % 1000) * 1000000;
+
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (!sw->stop && !sw->flush && vec_size(sw->vecReady) < sw->flushBytes)
+            if (pthread_cond_timedwait(&sw->wake, &sw->mtx, &deadline))
+                break; // timed out: write what is ready, if anything
+
+        // Incomplete sample blocks are only written at the end (checkpoints save them instead)
+        const bool final = sw->stop;
+
+        if (vec_size(sw->vecReady) || (final && vec_size(e->vecCarry))) {
+            swap(vecBatch, sw->vecReady);
+            vec_clear(sw->vecReady);
+            pthread_mutex_unlock(&sw->mtx);
+
+            encoder_write(e, vecBatch, vec_size(vecBatch), final, sw->out);
+            DIE_IF(fflush(sw->out) < 0);
+
+            pthread_mutex_lock(&sw->mtx);
+        }
+
+        // Done when everything is written, including incomplete sample blocks at the end (if the
+        // end was requested while writing, they are written by the next iteration)
+        const bool done = !vec_size(sw->vecReady) && (!sw->stop || !vec_size(e->vecCarry));
+
+        if (done) {
+            sw->flush = false;
+            pthread_cond_broadcast(&sw->idle);
+        }
+
+        if (sw->stop && done)
+            break;
+    }
+
+    pthread_mutex_unlock(&sw->mtx);
+    vec_destroy(vecBatch);
+    return NULL;
 }
 
-static void seq_str_destroy(SeqStr *ss) { str_destroy(&ss->str); }
+SeqWriter seq_writer_init(const char *fileName, const char *mode, int flags, int64_t flushMsec,
+                          size_t flushBytes, size_t maxQueued) {
+    SeqWriter sw = {.out = fopen(fileName, mode),
+                    .vecRing = vec_init_reserve(RING_SIZE, SeqBuf),
+                    .vecReady = vec_init(char),
+                    .encoder = encoder_init(flags),
+                    .flushMsec = flushMsec,
+                    .flushBytes = flushBytes,
+                    .maxQueued = maxQueued,
+                    .flags = flags};
+    DIE_IF(!sw.out);
 
-SeqWriter seq_writer_init(const char *fileName, const char *mode) {
-    SeqWriter sw = {.out = fopen(fileName, mode), .vecQueued = vec_init(SeqStr)};
+    for (size_t i = 0; i < RING_SIZE; i++)
+        vec_push(sw.vecRing, (SeqBuf){0});
 
     pthread_mutex_init(&sw.mtx, NULL);
+    pthread_cond_init(&sw.wake, NULL);
+    pthread_cond_init(&sw.idle, NULL);
     return sw;
 }
 
 void seq_writer_destroy(SeqWriter *sw) {
+    // Stop the writer thread, which writes what remains first
+    if (sw->started) {
+        pthread_mutex_lock(&sw->mtx);
+        sw->stop = true;
+        pthread_cond_signal(&sw->wake);
+        pthread_mutex_unlock(&sw->mtx);
+        pthread_join(sw->thread, NULL);
+    } else if (vec_size(sw->encoder.vecCarry)) {
+        // Nothing pushed since resume: write the incomplete sample block restored by the checkpoint
+        encoder_write(&sw->encoder, "", 0, true, sw->out);
+    }
+
+    pthread_cond_destroy(&sw->idle);
+    pthread_cond_destroy(&sw->wake);
     pthread_mutex_destroy(&sw->mtx);
-    vec_destroy_rec(sw->vecQueued, seq_str_destroy);
-    fclose(sw->out);
+    vec_destroy_rec(sw->vecRing, seq_buf_destroy);
+    vec_destroy(sw->vecReady);
+    encoder_destroy(&sw->encoder);
+    DIE_IF(fclose(sw->out) < 0);
+
+    if (sw->spill)
+        fclose(sw->spill);
 }
 
-void seq_writer_push(SeqWriter *sw, size_t idx, str_t str) {
+void seq_writer_push(SeqWriter *sw, size_t idx, const char *buf, size_t len) {
     pthread_mutex_lock(&sw->mtx);
 
-    // Append to sw->vecQueued[n]
-    const size_t n = vec_size(sw->vecQueued);
-    vec_push(sw->vecQueued, seq_str_init(idx, str));
+    // Start the writer thread on first use (sw is returned by value from seq_writer_init())
+    if (!sw->started) {
+        pthread_create(&sw->thread, NULL, seq_writer_thread, sw);
+        sw->started = true;
+    }
+
+    seq_writer_queue(sw, idx, buf, len);
 
-    // insert in correct position
-    for (size_t i = 0; i < n; i++)
-        if (sw->vecQueued[i].idx > idx) {
-            SeqStr tmp = sw->vecQueued[n];
-            memmove(&sw->vecQueued[i + 1], &sw->vecQueued[i], (n - i) * sizeof(SeqStr));
-            sw->vecQueued[i] = tmp;
-            break;
-        }
+    // Move the sequential buffers, starting at idxNext, to the data ready to be written. Spilled
+    // buffers are read from disk without the mutex, so one thread at a time does it, while others
+    // only queue their buffers (which it picks up).
+    if (idx == sw->idxNext && !sw->draining) {
+        char *vecSpilled = vec_init(char);
+        sw->draining = true;
 
-    // Calculate i such that buf[0..i-1] is the longest sequential chunk
-    size_t i = 0;
-    for (; i < vec_size(sw->vecQueued); i++)
-        if (sw->vecQueued[i].idx != sw->idxNext + i) {
-            assert(sw->vecQueued[i].idx > sw->idxNext + i);
-            break;
-        }
+        for (SeqBuf *sb; (sb = seq_writer_slot(sw, sw->idxNext))->queued; sw->idxNext++) {
+            if (sb->spilled) {
+                const SeqBuf spilled = *sb;
+                vec_clear(vecSpilled);
+
+                pthread_mutex_unlock(&sw->mtx);
+                seq_writer_read(sw, &spilled, &vecSpilled);
+                pthread_mutex_lock(&sw->mtx);
+
+                vec_push_n(sw->vecReady, vecSpilled, spilled.len);
+                sw->spilledCount--;
+                sb = seq_writer_slot(sw, sw->idxNext); // the ring may have grown meanwhile
+            } else {
+                vec_push_n(sw->vecReady, sb->vecData, sb->len);
+                sw->queuedBytes -= sb->len;
+            }
 
-    if (i) {
-        // Write buf[0..i-1] to file, and destroy elements
-        for (size_t j = 0; j < i; j++) {
-            fputs(sw->vecQueued[j].str.buf, sw->out);
-            seq_str_destroy(&sw->vecQueued[j]);
+            seq_buf_destroy(sb);
+            *sb = (SeqBuf){0};
         }
-        fflush(sw->out);
 
-        // Delete buf[0..i-1]
-        memmove(&sw->vecQueued[0], &sw->vecQueued[i],
-                (vec_size(sw->vecQueued) - i) * sizeof(SeqStr));
-        vec_ptr(sw->vecQueued)->size -= i;
+        sw->draining = false;
+        vec_destroy(vecSpilled);
 
-        // Updated next expected index
-        sw->idxNext += i;
+        // Reuse the spill file from the start, once there is nothing left in it
+        if (!sw->spilledCount)
+            sw->spillEnd = 0;
+
+        if (vec_size(sw->vecReady) >= sw->flushBytes)
+            pthread_cond_signal(&sw->wake);
     }
 
     pthread_mutex_unlock(&sw->mtx);
 }
+
+void seq_writer_save(SeqWriter *sw, FILE *out) {
+    pthread_mutex_lock(&sw->mtx);
+
+    // Wait for the writer thread to write everything that is ready. It then remains idle while we
+    // hold the mutex.
+    if (sw->started) {
+        sw->flush = true;
+        pthread_cond_signal(&sw->wake);
+
+        while (sw->flush)
+            pthread_cond_wait(&sw->idle, &sw->mtx);
+    }
+
+    DIE_IF(file_sync(sw->out) < 0);
+    const long size = ftell(sw->out);
+    DIE_IF(size < 0);
+
+    const size_t ringSize = vec_size(sw->vecRing);
+    size_t queued = 0;
+
+    for (size_t i = 0; i < ringSize; i++)
+        queued += sw->vecRing[i].queued;
+
+    DIE_IF(fprintf(out, "seqwriter %ld %zu %zu\n", size, sw->idxNext, queued) < 0);
+
+    // Queued buffers: idx and length on one line, followed by the raw data
+    char *vecData = vec_init(char);
+
+    for (size_t idx = sw->idxNext; idx < sw->idxNext + ringSize; idx++) {
+        const SeqBuf *sb = seq_writer_slot(sw, idx);
+
+        if (sb->queued) {
+            vec_clear(vecData);
+            seq_writer_read(sw, sb, &vecData);
+            DIE_IF(fprintf(out, "%zu %zu\n", idx, sb->len) < 0);
+            DIE_IF(fwrite(vecData, 1, sb->len, out) != sb->len);
+        }
+    }
+
+    vec_destroy(vecData);
+    encoder_save(&sw->encoder, out);
+    pthread_mutex_unlock(&sw->mtx);
+}
+
+void seq_writer_load(SeqWriter *sw, FILE *in) {
+    long size = 0;
+    size_t queued = 0;
+
+    if (fscanf(in, " seqwriter %ld %zu %zu", &size, &sw->idxNext, &queued) != 3)
+        DIE("invalid checkpoint\n");
+
+    // The file cannot be shorter than when the checkpoint was written (which synced it to disk)
+    DIE_IF(fseek(sw->out, 0, SEEK_END) < 0);
+
+    if (ftell(sw->out) < size)
+        DIE("file is shorter than in the checkpoint\n");
+
+    DIE_IF(file_truncate(sw->out, size) < 0);
+    DIE_IF(fseek(sw->out, 0, SEEK_END) < 0); // so that ftell() reports the truncated size
+
+    for (size_t i = 0; i < queued; i++) {
+        size_t idx = 0, len = 0;
+
+        if (fscanf(in, "%zu %zu", &idx, &len) != 2 || fgetc(in) != '\n' || idx < sw->idxNext)
+            DIE("invalid checkpoint\n");
+
+        char *vecData = vec_init_reserve(len, char);
+        vec_ptr(vecData)->size = len;
+
+        if (fread(vecData, 1, len, in) != len)
+            DIE("invalid checkpoint\n");
+
+        seq_writer_queue(sw, idx, vecData, len);
+        vec_destroy(vecData);
+    }
+
+    encoder_load(&sw->encoder, in);
+}
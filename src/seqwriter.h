@@ -13,23 +13,66 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
-#include "str.h"
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+// Encoding of output files: pack binary samples in blocks (see samples.h), compress as gzip members
+enum { ENCODE_BLOCKS = 1, ENCODE_GZIP = 2 };
+
 typedef struct {
-    size_t idx;
-    str_t str;
-} SeqStr;
+    char *vecCarry; // samples that do not fill a block yet
+    char *vecPacked, *vecCompressed;
+    int flags;
+} Encoder;
+
+Encoder encoder_init(int flags);
+void encoder_destroy(Encoder *e);
+
+// Encode buf[0..len-1] and write the result to out. With 'final', incomplete sample blocks are
+// written too.
+void encoder_write(Encoder *e, const char *buf, size_t len, bool final, FILE *out);
+
+// Save/load the samples of the incomplete block, for checkpoint and resume. They are kept in the
+// checkpoint, rather than written as a short block.
+void encoder_save(const Encoder *e, FILE *out);
+void encoder_load(Encoder *e, FILE *in);
 
+typedef struct {
+    char *vecData; // data, if in memory
+    long offset;   // position of the data in the spill file, if spilled
+    size_t len;
+    bool queued, spilled;
+} SeqBuf;
+
+// Buffers are pushed by many threads, in any order, and written to the file in order, by a
+// dedicated writer thread. It writes what is ready every flushMsec milliseconds, or as soon as
+// flushBytes are ready, whichever comes first, encoded according to 'flags'. Buffers waiting for
+// an earlier one are queued in a ring buffer, and spilled to a temporary file beyond maxQueued
+// bytes.
 typedef struct {
     pthread_mutex_t mtx;
-    SeqStr *vecQueued;
-    FILE *out;
-    size_t idxNext;
+    pthread_cond_t wake, idle; // wake up the writer thread; writer thread has nothing left to write
+    pthread_t thread;
+    SeqBuf *vecRing; // vecRing[idx % size] for idxNext <= idx < idxNext + size (size is 2^n)
+    char *vecReady;  // sequential data, ready to be written
+    Encoder encoder; // used by the writer thread, or by seq_writer_save() while it is idle
+    FILE *out, *spill;
+    long spillEnd;
+    size_t idxNext, flushBytes, queuedBytes, maxQueued, spilledCount;
+    int64_t flushMsec;
+    int flags;
+    bool started, flush, stop, draining; // draining: a producer moves buffers to vecReady
 } SeqWriter;
 
-SeqWriter seq_writer_init(const char *fileName, const char *mode);
+SeqWriter seq_writer_init(const char *fileName, const char *mode, int flags, int64_t flushMsec,
+                          size_t flushBytes, size_t maxQueued);
 void seq_writer_destroy(SeqWriter *sw);
 
-void seq_writer_push(SeqWriter *sw, size_t idx, str_t str);
+void seq_writer_push(SeqWriter *sw, size_t idx, const char *buf, size_t len);
+
+// Save/load the state of the writer, for checkpoint and resume. On load, the file is truncated to
+// its saved size, discarding anything written after the checkpoint.
+void seq_writer_save(SeqWriter *sw, FILE *out);
+void seq_writer_load(SeqWriter *sw, FILE *in);
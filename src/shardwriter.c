@@ -0,0 +1,116 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "shardwriter.h"
+#include "gzip.h"
+#include "util.h"
+#include "vec.h"
+#include <string.h>
+
+// Write buffered data. Incomplete sample blocks are only written if 'final'.
+static void shard_writer_flush(ShardWriter *sw, bool final) {
+    encoder_write(&sw->encoder, sw->vecBuf, vec_size(sw->vecBuf), final, sw->out);
+    DIE_IF(fflush(sw->out) < 0);
+    vec_clear(sw->vecBuf);
+}
+
+ShardWriter shard_writer_init(const char *fileName, const char *mode, int flags,
+                              size_t flushBytes) {
+    ShardWriter sw = {.out = fopen(fileName, mode),
+                      .vecBuf = vec_init(char),
+                      .encoder = encoder_init(flags),
+                      .flushBytes = flushBytes};
+    DIE_IF(!sw.out);
+    return sw;
+}
+
+void shard_writer_destroy(ShardWriter *sw) {
+    shard_writer_flush(sw, true);
+    encoder_destroy(&sw->encoder);
+    vec_destroy(sw->vecBuf);
+    DIE_IF(fclose(sw->out) < 0);
+}
+
+void shard_writer_push(ShardWriter *sw, const char *buf, size_t len) {
+    vec_push_n(sw->vecBuf, buf, len);
+
+    if (vec_size(sw->vecBuf) >= sw->flushBytes)
+        shard_writer_flush(sw, false);
+}
+
+void shard_writer_save(ShardWriter *sw, FILE *out) {
+    shard_writer_flush(sw, false);
+    DIE_IF(file_sync(sw->out) < 0);
+
+    const long size = ftell(sw->out);
+    DIE_IF(size < 0);
+    DIE_IF(fprintf(out, "shard %ld\n", size) < 0);
+    encoder_save(&sw->encoder, out);
+}
+
+void shard_writer_load(ShardWriter *sw, FILE *in) {
+    long size = 0;
+
+    if (fscanf(in, " shard %ld", &size) != 1)
+        DIE("invalid checkpoint\n");
+
+    DIE_IF(fseek(sw->out, 0, SEEK_END) < 0);
+
+    if (ftell(sw->out) < size)
+        DIE("file is shorter than in the checkpoint\n");
+
+    DIE_IF(file_truncate(sw->out, size) < 0);
+    DIE_IF(fseek(sw->out, 0, SEEK_END) < 0); // so that ftell() reports the truncated size
+    encoder_load(&sw->encoder, in);
+}
+
+void shard_file_name(const char *fileName, int id, str_t *out) {
+    const size_t end = strlen(fileName) - (gzip_file_name(fileName) ? 3 : 0);
+    const char *base = strrchr(fileName, '/');
+    size_t dot = end;
+
+    for (size_t i = base ? (size_t)(base - fileName) : 0; i < end; i++)
+        if (fileName[i] == '.')
+            dot = i;
+
+    str_ncpy(out, str_ref(fileName), dot);
+    str_cat_fmt(out, ".%i%s", id, &fileName[dot]);
+}
+
+void shard_writer_merge(const char *outName, const char **inNames, int n) {
+    // Concatenated gzip members are a valid gzip file, but gzip and plain files cannot be mixed
+    for (int i = 0; i < n; i++) {
+        if (gzip_file_name(inNames[i]) != gzip_file_name(outName))
+            DIE("cannot merge '%s' into '%s': both must be compressed (.gz), or neither\n",
+                inNames[i], outName);
+
+        if (!strcmp(inNames[i], outName))
+            DIE("cannot merge '%s' into itself\n", outName);
+    }
+
+    FILE *out = fopen(outName, "w" FOPEN_BINARY);
+    DIE_IF(!out);
+
+    for (int i = 0; i < n; i++) {
+        size_t size = 0;
+        const char *map = file_map(inNames[i], &size);
+
+        if (map) {
+            DIE_IF(fwrite(map, 1, size, out) != size);
+            file_unmap(map, size);
+        }
+    }
+
+    DIE_IF(fclose(out) < 0);
+}
@@ -0,0 +1,42 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "seqwriter.h"
+#include "str.h"
+
+// Output file written by a single thread, in the order data is pushed (eg. one sample file per
+// worker). Data is buffered, and written when flushBytes are buffered, encoded according to 'flags'
+// (see seqwriter.h).
+typedef struct {
+    FILE *out;
+    char *vecBuf; // buffered data
+    Encoder encoder;
+    size_t flushBytes;
+} ShardWriter;
+
+ShardWriter shard_writer_init(const char *fileName, const char *mode, int flags, size_t flushBytes);
+void shard_writer_destroy(ShardWriter *sw);
+
+void shard_writer_push(ShardWriter *sw, const char *buf, size_t len);
+
+// Save/load the state of the writer, for checkpoint and resume (see seq_writer_save/load()).
+void shard_writer_save(ShardWriter *sw, FILE *out);
+void shard_writer_load(ShardWriter *sw, FILE *in);
+
+// File name of shard 'id', inserted before the extension: sample.csv.gz -> sample.3.csv.gz
+void shard_file_name(const char *fileName, int id, str_t *out);
+
+// Concatenate files inNames[0..n-1] into outName (-merge mode)
+void shard_writer_merge(const char *outName, const char **inNames, int n);
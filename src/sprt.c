@@ -17,16 +17,32 @@
 
 static double elo_to_score(double elo) { return 1 / (1 + exp(-elo * log(10) / 400)); }
 
-// Uses asymptotic LLR approximation in the trinomial GSPRT model. See:
+// Uses asymptotic LLR approximation in the GSPRT model. See:
 // http://hardy.uhasselt.be/Toga/GSPRT_approximation.pdf
-static double sprt_llr(int wldCount[NB_RESULT], double elo0, double elo1) {
-    if (!!wldCount[0] + !!wldCount[1] + !!wldCount[2] < 2) // at least 2 among 3 must be non zero
+// Generic version, for a multinomial distribution: count[i] observations of score[i] in [0,1].
+// Like fishtest, zero counts are replaced by a small epsilon, so that the variance is never zero
+// (eg. with -repeat, a deterministic engine pair only plays game pairs scoring 1 point).
+static double sprt_llr(const int *count, const double *score, int size, double elo0, double elo1) {
+    double c[size], n = 0;
+    int games = 0;
+
+    for (int i = 0; i < size; i++) {
+        games += count[i];
+        c[i] = fmax(count[i], 1e-3);
+        n += c[i];
+    }
+
+    if (!games)
         return 0;
 
-    const int n = wldCount[RESULT_WIN] + wldCount[RESULT_LOSS] + wldCount[RESULT_DRAW];
-    const double w = (double)wldCount[RESULT_WIN] / n, l = (double)wldCount[RESULT_LOSS] / n,
-                 d = 1 - w - l;
-    const double s = w + d / 2, var = (w + d / 4) - s * s;
+    double s = 0, s2 = 0;
+
+    for (int i = 0; i < size; i++) {
+        s += c[i] * score[i] / n;
+        s2 += c[i] * score[i] * score[i] / n;
+    }
+
+    const double var = s2 - s * s;
     const double s0 = elo_to_score(elo0), s1 = elo_to_score(elo1);
 
     return (s1 - s0) * (2 * s - s0 - s1) / (2 * var / n);
@@ -36,10 +52,16 @@ bool sprt_validate(const SPRTParam *sp) {
     return 0 < sp->alpha && sp->alpha < 1 && 0 < sp->beta && sp->beta < 1 && sp->elo0 < sp->elo1;
 }
 
-bool sprt_done(int wldCount[NB_RESULT], const SPRTParam *sp) {
+bool sprt_done(const int wldCount[NB_RESULT], const int penta[5], const SPRTParam *sp) {
+    // Trinomial: score of a game (loss, draw, win). Pentanomial: score of a game pair, per game.
+    static const double trinomial[NB_RESULT] = {0, 0.5, 1};
+    static const double pentanomial[5] = {0, 0.25, 0.5, 0.75, 1};
+
     const double lbound = log(sp->beta / (1 - sp->alpha));
     const double ubound = log((1 - sp->beta) / sp->alpha);
-    const double llr = sprt_llr(wldCount, sp->elo0, sp->elo1);
+    const double llr = sp->pentanomial
+                           ? sprt_llr(penta, pentanomial, 5, sp->elo0, sp->elo1)
+                           : sprt_llr(wldCount, trinomial, NB_RESULT, sp->elo0, sp->elo1);
 
     if (llr > ubound) {
         printf("SPRT: LLR = %.3f [%.3f,%.3f]. H1 accepted.\n", llr, lbound, ubound);
@@ -17,7 +17,8 @@
 
 typedef struct {
     double elo0, elo1, alpha, beta;
+    bool pentanomial; // model game pairs (requires -repeat), rather than individual games
 } SPRTParam;
 
 bool sprt_validate(const SPRTParam *sp);
-bool sprt_done(int wldCount[NB_RESULT], const SPRTParam *sp);
+bool sprt_done(const int wldCount[NB_RESULT], const int penta[5], const SPRTParam *sp);
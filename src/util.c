@@ -13,6 +13,17 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #include "util.h"
+#ifdef __MINGW32__
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <io.h>
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 #include <assert.h>
 #include <errno.h>
 #include <stdarg.h>
@@ -44,6 +55,16 @@ void system_sleep(int64_t msec) {
     nanosleep(&t, NULL);
 }
 
+int system_cpus(void) {
+#ifdef __MINGW32__
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    return max((int)sysconf(_SC_NPROCESSORS_ONLN), 1);
+#endif
+}
+
 _Noreturn void die_errno(const char *fileName, int line) {
     stdio_lock(stdout); // lock stderr (fprintf) and stdout (explicitely), to prevent interleaving
     fprintf(stderr, "[%d] error in %s: (%d). %s\n", threadId, fileName, line, strerror(errno));
@@ -66,3 +87,104 @@ void stdio_unlock(FILE *f) {
     funlockfile(f);
 #endif
 }
+
+int file_truncate(FILE *f, long size) {
+#ifdef __MINGW32__
+    return _chsize(_fileno(f), size);
+#else
+    return ftruncate(fileno(f), size);
+#endif
+}
+
+int file_sync(FILE *f) {
+    if (fflush(f) < 0)
+        return -1;
+
+#ifdef __MINGW32__
+    return _commit(_fileno(f));
+#else
+    return fsync(fileno(f));
+#endif
+}
+
+int file_read_at(FILE *f, void *buf, size_t len, long offset) {
+#ifdef __MINGW32__
+    OVERLAPPED ov = {.Offset = (DWORD)offset, .OffsetHigh = (DWORD)((uint64_t)offset >> 32)};
+    DWORD n = 0;
+    return ReadFile((HANDLE)_get_osfhandle(_fileno(f)), buf, (DWORD)len, &n, &ov) && n == len
+               ? 0
+               : -1;
+#else
+    for (ssize_t n; len; len -= (size_t)n, offset += n, buf = (char *)buf + n)
+        if ((n = pread(fileno(f), buf, len, offset)) <= 0)
+            return -1;
+
+    return 0;
+#endif
+}
+
+void file_close(FILE **f) {
+    if (*f)
+        DIE_IF(fclose(*f) < 0);
+}
+
+int file_replace(const char *from, const char *to) {
+#ifdef __MINGW32__
+    // rename() does not overwrite an existing file on Windows
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+const char *file_map(const char *fileName, size_t *size) {
+#ifdef __MINGW32__
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    DIE_IF(file == INVALID_HANDLE_VALUE);
+
+    LARGE_INTEGER fileSize = {0};
+    DIE_IF(!GetFileSizeEx(file, &fileSize));
+    *size = (size_t)fileSize.QuadPart;
+    const char *map = NULL;
+
+    if (*size) {
+        // The view keeps a reference on the mapping, which keeps a reference on the file
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        DIE_IF(!mapping);
+        DIE_IF(!(map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)));
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+#else
+    const int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    DIE_IF(fd < 0);
+
+    struct stat st = {0};
+    DIE_IF(fstat(fd, &st) < 0);
+    *size = (size_t)st.st_size;
+    const char *map = NULL;
+
+    if (*size) {
+        // The mapping remains valid after the file descriptor is closed
+        map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        DIE_IF(map == MAP_FAILED);
+    }
+
+    DIE_IF(close(fd) < 0);
+#endif
+    return map;
+}
+
+void file_unmap(const char *map, size_t size) {
+    if (!map)
+        return;
+
+#ifdef __MINGW32__
+    (void)size;
+    DIE_IF(!UnmapViewOfFile(map));
+#else
+    DIE_IF(munmap((void *)map, size) < 0);
+#endif
+}
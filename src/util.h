@@ -54,6 +54,7 @@ double prngf(uint64_t *state);
 
 int64_t system_msec(void);
 void system_sleep(int64_t msec);
+int system_cpus(void);
 
 #define DIE(...)                                                                                   \
     do {                                                                                           \
@@ -71,3 +72,23 @@ _Noreturn void die_errno(const char *fileName, int line);
 
 void stdio_lock(FILE *f);
 void stdio_unlock(FILE *f);
+
+// Truncate file 'f' to 'size' bytes. Returns -1 on error (errno set).
+int file_truncate(FILE *f, long size);
+
+// Flush 'f' all the way to the disk (not just the OS). Returns -1 on error.
+int file_sync(FILE *f);
+
+// Read 'len' bytes at 'offset' of file 'f', bypassing its stdio buffer and position, so that it can
+// be done concurrently with (flushed) writes elsewhere in the file. Returns -1 on error.
+int file_read_at(FILE *f, void *buf, size_t len, long offset);
+
+// Cleanup function for scope(): close the file, if any
+void file_close(FILE **f);
+
+// Atomically replace file 'to' with file 'from'. Returns -1 on error.
+int file_replace(const char *from, const char *to);
+
+// Map file 'fileName' in memory (read only), and set *size. Returns NULL for an empty file.
+const char *file_map(const char *fileName, size_t *size);
+void file_unmap(const char *map, size_t size);
@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 typedef struct {
     size_t capacity;
@@ -60,4 +61,13 @@ void *vec_do_grow(void *v, size_t esize, size_t n);
         (v)[vec_ptr(v)->size++] = (e);                                                             \
     })
 
+// append n elements from src[]
+#define vec_push_n(v, src, n)                                                                      \
+    ({                                                                                             \
+        const size_t _n = (n);                                                                     \
+        v = vec_do_grow(v, sizeof(*v), _n);                                                        \
+        memcpy(&(v)[vec_ptr(v)->size], src, _n * sizeof(*v));                                     \
+        vec_ptr(v)->size += _n;                                                                    \
+    })
+
 #define vec_pop(v) ({ (v)[--vec_ptr(v)->size]; })
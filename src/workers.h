@@ -24,15 +24,10 @@ enum { RESULT_LOSS, RESULT_DRAW, RESULT_WIN, NB_RESULT };
 
 // Per thread data
 typedef struct {
-    struct {
-        pthread_mutex_t mtx;
-        int64_t timeLimit;
-        str_t engineName;
-        bool set;
-    } deadline;
     FILE *log;
-    uint64_t seed; // seed for prng()
-    int id;        // starts at 1 (0 is for main thread)
+    struct IOTask *task; // coroutine, if driven by an event loop (see ioloop.h)
+    uint64_t seed;       // seed for prng()
+    int id;              // starts at 1 (0 is for main thread)
 } Worker;
 
 extern Worker *vecWorkers;
@@ -40,9 +35,5 @@ extern Worker *vecWorkers;
 Worker worker_init(int id, const char *logName);
 void worker_destroy(Worker *w);
 
-void deadline_set(Worker *w, const char *engineName, int64_t now, int64_t timeLimit);
-void deadline_clear(Worker *w);
-bool deadline_overdue(Worker *w);
-
 void workers_busy_add(int n);
 int workers_busy_count(void);
@@ -0,0 +1,163 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+// Stand alone program: perft (number of leaf nodes of the legal move tree) to check and benchmark
+// the move generator, on a suite of positions with their expected counts
+#include "gen.h"
+#include "str.h"
+#include "util.h"
+#include "vec.h"
+#include <pthread.h>
+#include <string.h>
+
+enum { MAX_DEPTH = 16 };
+
+typedef struct {
+    const Position *root;
+    move_t *vecRootMoves;
+    size_t next;    // next root move to search (atomic)
+    uint64_t nodes; // total so far (atomic)
+    int depth;
+} Search;
+
+static bool bulk = true;
+
+// With bulk counting, leaf nodes are counted (depth 1 returns the number of legal moves) instead of
+// visited (played, like any other node)
+static uint64_t perft(const Position *pos, int depth, move_t *vecMoves[MAX_DEPTH]) {
+    if (depth <= 0)
+        return 1;
+
+    vecMoves[depth] = gen_all_moves(pos, vecMoves[depth]);
+
+    if (depth == 1 && bulk)
+        return vec_size(vecMoves[depth]);
+
+    uint64_t nodes = 0;
+
+    for (size_t i = 0; i < vec_size(vecMoves[depth]); i++) {
+        Position after;
+        pos_move(&after, pos, vecMoves[depth][i]);
+        nodes += perft(&after, depth - 1, vecMoves);
+    }
+
+    return nodes;
+}
+
+// Threads split the root moves: each one takes the next root move, until there are none left
+static void *thread_start(void *arg) {
+    Search *s = arg;
+    move_t *vecMoves[MAX_DEPTH];
+    size_t i = 0;
+
+    for (int d = 0; d < MAX_DEPTH; d++)
+        vecMoves[d] = vec_init_reserve(64, move_t);
+
+    while ((i = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED)) < vec_size(s->vecRootMoves)) {
+        Position after;
+        pos_move(&after, s->root, s->vecRootMoves[i]);
+        __atomic_fetch_add(&s->nodes, perft(&after, s->depth - 1, vecMoves), __ATOMIC_RELAXED);
+    }
+
+    for (int d = 0; d < MAX_DEPTH; d++)
+        vec_destroy(vecMoves[d]);
+
+    return NULL;
+}
+
+static uint64_t perft_root(const Position *pos, int depth, int threads) {
+    Search s = {.root = pos, .vecRootMoves = gen_all_moves(pos, vec_init(move_t)), .depth = depth};
+    pthread_t tids[threads];
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, thread_start, &s);
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+
+    vec_destroy(s.vecRootMoves);
+    return s.nodes;
+}
+
+int main(int argc, const char **argv) {
+    const char *fileName = "test/perft.epd";
+    int threads = 1, maxDepth = MAX_DEPTH - 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+            threads = max(atoi(argv[++i]), 1);
+        else if (!strcmp(argv[i], "-depth") && i + 1 < argc)
+            maxDepth = min(atoi(argv[++i]), MAX_DEPTH - 1);
+        else if (!strcmp(argv[i], "-nobulk"))
+            bulk = false;
+        else if (argv[i][0] != '-')
+            fileName = argv[i];
+        else
+            DIE("usage: perft [-threads N] [-depth N] [-nobulk] [FILE]\n");
+    }
+
+    // Each line is 'FEN;D1 count;D2 count;...': search the deepest one, up to maxDepth
+    FILE *in = fopen(fileName, "r" FOPEN_TEXT);
+    DIE_IF(!in);
+
+    scope(str_destroy) str_t line = str_init(), fen = str_init(), token = str_init();
+    uint64_t total = 0;
+    int positions = 0, failed = 0;
+    const int64_t start = system_msec();
+
+    while (str_getline(&line, in)) {
+        const char *tail = str_tok(line.buf, &fen, ";");
+        int depth = 0;
+        uint64_t expected = 0;
+
+        if (!tail)
+            continue;
+
+        while ((tail = str_tok(tail, &token, ";"))) {
+            int d = 0;
+            uint64_t count = 0;
+
+            if (sscanf(token.buf, "D%d %" SCNu64, &d, &count) == 2 && d <= maxDepth && d > depth) {
+                depth = d;
+                expected = count;
+            }
+        }
+
+        Position pos;
+
+        if (!pos_set(&pos, fen.buf, false))
+            DIE("illegal FEN '%s'\n", fen.buf);
+
+        if (!depth)
+            continue;
+
+        const uint64_t nodes = perft_root(&pos, depth, threads);
+        total += nodes;
+        positions++;
+
+        if (nodes != expected) {
+            printf("%s: perft(%d) = %" PRIu64 ", expected %" PRIu64 "\n", fen.buf, depth, nodes,
+                   expected);
+            failed++;
+        }
+    }
+
+    DIE_IF(fclose(in) < 0);
+
+    const int64_t elapsed = max(system_msec() - start, (int64_t)1);
+    printf("%d positions, %d failed, %" PRIu64 " nodes in %.3fs (%.0f nodes/s)\n", positions,
+           failed, total, elapsed / 1000.0, total * 1000.0 / elapsed);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,771 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+// Stand alone program: validate, convert, merge, split and shuffle sample files. Input files are
+// memory mapped and cut in pieces, processed by many threads, so they can be far larger than RAM.
+// Cutting bin files is a sequential scan of all records, so bin2 should be preferred.
+#include "gzip.h"
+#include "position.h"
+#include "samples.h"
+#include "seqwriter.h"
+#include "shardwriter.h"
+#include "util.h"
+#include "vec.h"
+#include <pthread.h>
+#include <string.h>
+
+enum { FORMAT_CSV, FORMAT_BIN, FORMAT_BIN2 };
+static const char *FormatName[] = {"csv", "bin", "bin2"};
+
+// Pieces are the unit of work of threads: about PIECE_SIZE bytes of input (a multiple of the bin2
+// block size, so that they cut bin2 files on block boundaries)
+enum { PIECE_SIZE = 1 << 22, BUCKET_BUFFER = 1 << 16 };
+
+enum { MODE_VALIDATE, MODE_WRITE, MODE_SCATTER, MODE_GATHER, MODE_BENCH };
+
+typedef struct {
+    const char *name, *map;
+    size_t size;
+    int format;
+} Input;
+
+typedef struct {
+    size_t input;      // index in vecInputs[] (bucket index in MODE_GATHER)
+    size_t start, end; // range of bytes
+} Piece;
+
+typedef struct {
+    uint64_t samples, invalid, results[3]; // results: loss, draw, win (from the side to move)
+    size_t firstInvalid;                   // offset of the first invalid sample
+} Stats;
+
+// Shuffle: samples are scattered in random buckets (temporary files), which are then shuffled in
+// memory, one by one
+typedef struct {
+    pthread_mutex_t mtx;
+    FILE *file;
+    char *vecBuf; // samples not written yet
+} Bucket;
+
+static Input *vecInputs;
+static Piece *vecPieces;
+static Stats *vecStats; // by input
+static SeqWriter *vecWriters;
+static Bucket *vecBuckets;
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t nextPiece; // next piece to process (atomic)
+
+static int mode, threads, outFormat = -1;
+static uint64_t seed;
+static size_t memory = (size_t)1 << 30;
+
+static int16_t record_score(const char *rec, size_t bytes) {
+    return (int16_t)((uint8_t)rec[bytes - 3] | (uint8_t)rec[bytes - 2] << 8);
+}
+
+static size_t record_pack(const Position *pos, int score, int result, char *rec) {
+    PackedPos pp = {0};
+    const size_t bytes = pos_pack(pos, &pp);
+    score = score > INT16_MAX ? INT16_MAX : score < INT16_MIN ? INT16_MIN : score;
+
+    memcpy(rec, &pp, bytes);
+    rec[bytes] = (char)score;
+    rec[bytes + 1] = (char)(score >> 8);
+    rec[bytes + 2] = (char)result;
+    return bytes + 3;
+}
+
+// pos_unpack() does not know about chess960: detect it like pos_set() does, for FEN output
+static void record_unpack(const char *rec, size_t bytes, Position *pos) {
+    PackedPos pp = {0};
+    memcpy(&pp, rec, bytes - 3);
+    pos_unpack(pos, &pp);
+
+    for (bitboard_t rooks = pos->castleRooks; rooks && !pos->chess960;) {
+        const int rook = bb_pop_lsb(&rooks);
+        const int king = pos_king_square(pos, pos_color_on(pos, rook));
+
+        if ((FILE_A < file_of(rook) && file_of(rook) < FILE_H) || file_of(king) != FILE_E)
+            pos->chess960 = true;
+    }
+}
+
+// Check what pos_unpack() relies on (one king per color), the result, and the rule50 counter. With
+// 'full', also check that the position is valid, by converting it to FEN and back.
+static bool record_check(const char *rec, size_t bytes, bool full) {
+    if (bytes > SAMPLE_RECORD_MAX)
+        return false;
+
+    PackedPos pp = {0};
+    memcpy(&pp, rec, bytes - 3);
+    const int pieces = bb_count(pp.occ);
+    int kings[NB_COLOR] = {0};
+
+    if ((uint8_t)rec[bytes - 1] > 2 || pp.rule50 >= 100)
+        return false;
+
+    for (int i = 0; i < pieces; i++) {
+        const int nibble = (pp.packedPieces[i / 2] >> (i % 2 ? 4 : 0)) & 15;
+
+        if (nibble / 2 == KING)
+            kings[nibble & 1]++;
+    }
+
+    // Unused nibble must be zero
+    if (kings[WHITE] != 1 || kings[BLACK] != 1 || (pieces % 2 && pp.packedPieces[pieces / 2] >> 4))
+        return false;
+
+    if (!full)
+        return true;
+
+    Position pos = {0}, check = {0};
+    record_unpack(rec, bytes, &pos);
+    scope(str_destroy) str_t fen = str_init();
+    pos_get(&pos, &fen);
+    return pos_set(&check, fen.buf, false) && check.key == pos.key;
+}
+
+// Parse a 'FEN,Eval,Result' line into rec[]. Returns the record size, or 0 if invalid.
+static size_t csv_decode(const char *line, size_t len, char *rec) {
+    char buf[128] = "";
+
+    if (len && line[len - 1] == '\r')
+        len--;
+
+    if (len >= sizeof(buf))
+        return 0;
+
+    memcpy(buf, line, len);
+    char *comma2 = strrchr(buf, ','), *comma1 = NULL, *end = NULL;
+
+    if (!comma2)
+        return 0;
+
+    *comma2 = '\0';
+
+    if (!(comma1 = strrchr(buf, ',')))
+        return 0;
+
+    *comma1 = '\0';
+    const long score = strtol(comma1 + 1, &end, 10);
+    Position pos = {0};
+
+    if (end == comma1 + 1 || *end || score < INT16_MIN || score > INT16_MAX ||
+        comma2[1] < '0' || comma2[1] > '2' || comma2[2] || !pos_set(&pos, buf, false))
+        return 0;
+
+    return record_pack(&pos, (int)score, comma2[1] - '0', rec);
+}
+
+static void invalid_sample(const Input *in, Stats *stats, size_t offset) {
+    if (mode != MODE_VALIDATE)
+        DIE("%s: invalid sample at offset %zu\n", in->name, offset);
+
+    stats->invalid++;
+    stats->firstInvalid = min(stats->firstInvalid, offset);
+}
+
+// Decode the samples of a piece into bin records, appended to *vecRecords
+static void piece_decode(const Piece *pc, char **vecRecords, Stats *stats) {
+    const Input *in = &vecInputs[pc->input];
+    const char *map = in->map;
+    const bool full = mode == MODE_VALIDATE;
+
+    if (in->format == FORMAT_CSV) {
+        char rec[SAMPLE_RECORD_MAX];
+
+        for (size_t p = pc->start; p < pc->end;) {
+            const char *nl = memchr(&map[p], '\n', pc->end - p);
+            const size_t len = nl ? (size_t)(nl - &map[p]) : pc->end - p;
+            const size_t bytes = csv_decode(&map[p], len, rec);
+
+            if (bytes)
+                vec_push_n(*vecRecords, rec, bytes);
+            else if (len)
+                invalid_sample(in, stats, p);
+
+            p += len + 1;
+        }
+    } else if (in->format == FORMAT_BIN) {
+        for (size_t p = pc->start; p < pc->end;) {
+            const size_t bytes = p + 8 <= pc->end ? sample_record_size(&map[p]) : SIZE_MAX;
+
+            if (bytes > pc->end - p) {
+                invalid_sample(in, stats, p); // truncated
+                break;
+            }
+
+            if (record_check(&map[p], bytes, full))
+                vec_push_n(*vecRecords, &map[p], bytes);
+            else
+                invalid_sample(in, stats, p);
+
+            p += bytes;
+        }
+    } else {
+        size_t p = pc->start;
+
+        for (; p + SAMPLE_BLOCK_SIZE <= pc->end; p += SAMPLE_BLOCK_SIZE) {
+            const char *block = &map[p];
+            const int count = sample_block_check(block);
+
+            if (count < 0) {
+                invalid_sample(in, stats, p);
+                continue;
+            }
+
+            for (int i = 0; i < count; i++) {
+                const size_t offset = (uint8_t)block[SAMPLE_BLOCK_HEADER + 2 * i] |
+                                      (size_t)(uint8_t)block[SAMPLE_BLOCK_HEADER + 2 * i + 1] << 8;
+                const char *rec = &block[offset];
+                const size_t bytes =
+                    offset + 8 <= SAMPLE_BLOCK_SIZE ? sample_record_size(rec) : SIZE_MAX;
+
+                if (bytes <= SAMPLE_BLOCK_SIZE - offset && record_check(rec, bytes, full))
+                    vec_push_n(*vecRecords, rec, bytes);
+                else
+                    invalid_sample(in, stats, p + offset);
+            }
+        }
+
+        if (p < pc->end)
+            invalid_sample(in, stats, p); // truncated block
+    }
+}
+
+typedef struct {
+    uint32_t bucket, offset;
+} Entry;
+
+static int entry_compare(const void *a, const void *b) {
+    const Entry *ea = a, *eb = b;
+    return ea->bucket != eb->bucket ? (ea->bucket > eb->bucket ? 1 : -1)
+                                    : (ea->offset > eb->offset) - (ea->offset < eb->offset);
+}
+
+// Append records to bucket files, chosen at random. Records are grouped by bucket first, to lock
+// each bucket once per piece.
+static void piece_scatter(const char *vecRecords, uint64_t *rng) {
+    Entry *vecEntries = vec_init(Entry);
+
+    for (size_t offset = 0; offset < vec_size(vecRecords);
+         offset += sample_record_size(&vecRecords[offset])) {
+        const Entry e = {(uint32_t)(prng(rng) % vec_size(vecBuckets)), (uint32_t)offset};
+        vec_push(vecEntries, e);
+    }
+
+    const size_t n = vec_size(vecEntries);
+    qsort(vecEntries, n, sizeof(Entry), entry_compare);
+
+    for (size_t i = 0; i < n;) {
+        Bucket *b = &vecBuckets[vecEntries[i].bucket];
+        pthread_mutex_lock(&b->mtx);
+
+        for (const uint32_t bucket = vecEntries[i].bucket; i < n && vecEntries[i].bucket == bucket;
+             i++) {
+            const char *rec = &vecRecords[vecEntries[i].offset];
+            vec_push_n(b->vecBuf, rec, sample_record_size(rec));
+        }
+
+        if (vec_size(b->vecBuf) >= BUCKET_BUFFER) {
+            DIE_IF(fwrite(b->vecBuf, 1, vec_size(b->vecBuf), b->file) != vec_size(b->vecBuf));
+            vec_clear(b->vecBuf);
+        }
+
+        pthread_mutex_unlock(&b->mtx);
+    }
+
+    vec_destroy(vecEntries);
+}
+
+// Read a bucket file, and shuffle its records (Fisher-Yates)
+static void bucket_shuffle(Bucket *b, char **vecRecords, uint64_t *rng) {
+    char *vecData = vec_init(char);
+    DIE_IF(fseek(b->file, 0, SEEK_END) < 0);
+    const long size = ftell(b->file);
+    DIE_IF(size < 0 || fseek(b->file, 0, SEEK_SET) < 0);
+
+    vecData = vec_do_grow(vecData, 1, (size_t)size);
+    vec_ptr(vecData)->size = (size_t)size;
+    DIE_IF(fread(vecData, 1, (size_t)size, b->file) != (size_t)size);
+
+    uint32_t *vecOffsets = vec_init(uint32_t);
+
+    for (size_t offset = 0; offset < (size_t)size; offset += sample_record_size(&vecData[offset]))
+        vec_push(vecOffsets, (uint32_t)offset);
+
+    for (size_t i = vec_size(vecOffsets); i > 1; i--) {
+        const size_t j = prng(rng) % i;
+        swap(vecOffsets[i - 1], vecOffsets[j]);
+    }
+
+    for (size_t i = 0; i < vec_size(vecOffsets); i++) {
+        const char *rec = &vecData[vecOffsets[i]];
+        vec_push_n(*vecRecords, rec, sample_record_size(rec));
+    }
+
+    vec_destroy(vecOffsets);
+    vec_destroy(vecData);
+}
+
+// Encode records in the output format
+static void records_encode(const char *vecRecords, char **vecOut) {
+    if (outFormat != FORMAT_CSV) {
+        vec_push_n(*vecOut, vecRecords, vec_size(vecRecords)); // bin2 blocks made by SeqWriter
+        return;
+    }
+
+    scope(str_destroy) str_t line = str_init();
+
+    for (size_t p = 0; p < vec_size(vecRecords);) {
+        const size_t bytes = sample_record_size(&vecRecords[p]);
+        Position pos = {0};
+        record_unpack(&vecRecords[p], bytes, &pos);
+
+        pos_get(&pos, &line);
+        str_cat_fmt(&line, ",%i,%i\n", record_score(&vecRecords[p], bytes),
+                    (uint8_t)vecRecords[p + bytes - 1]);
+        vec_push_n(*vecOut, line.buf, line.len);
+        p += bytes;
+    }
+}
+
+static void records_count(const char *records, size_t size, Stats *stats) {
+    for (size_t p = 0; p < size;) {
+        const size_t bytes = sample_record_size(&records[p]);
+        stats->results[(uint8_t)records[p + bytes - 1]]++;
+        stats->samples++;
+        p += bytes;
+    }
+}
+
+static void stats_add(Stats *s, const Stats *add) {
+    s->samples += add->samples;
+    s->invalid += add->invalid;
+    s->firstInvalid = min(s->firstInvalid, add->firstInvalid);
+
+    for (int i = 0; i < 3; i++)
+        s->results[i] += add->results[i];
+}
+
+static void piece_process(size_t idx, char **vecRecords, char **vecOut) {
+    const Piece *pc = &vecPieces[idx];
+    Stats stats = {.firstInvalid = SIZE_MAX};
+    uint64_t rng = seed ^ (idx * 0xD1B54A32D192ED03ULL) ^ (mode == MODE_GATHER ? ~0ULL : 0);
+    vec_clear(*vecRecords);
+    vec_clear(*vecOut);
+
+    if (mode == MODE_GATHER) {
+        bucket_shuffle(&vecBuckets[pc->input], vecRecords, &rng);
+        records_encode(*vecRecords, vecOut);
+        seq_writer_push(&vecWriters[0], idx, *vecOut, vec_size(*vecOut));
+        return;
+    }
+
+    piece_decode(pc, vecRecords, &stats);
+    records_count(*vecRecords, vec_size(*vecRecords), &stats);
+
+    if (mode == MODE_WRITE) {
+        // Consecutive pieces go to the same output (split): piece idx to output idx * n / pieces
+        const size_t n = vec_size(vecWriters), pieces = vec_size(vecPieces);
+        const size_t out = idx * n / pieces, first = (out * pieces + n - 1) / n;
+        records_encode(*vecRecords, vecOut);
+        seq_writer_push(&vecWriters[out], idx - first, *vecOut, vec_size(*vecOut));
+    } else if (mode == MODE_SCATTER)
+        piece_scatter(*vecRecords, &rng);
+
+    pthread_mutex_lock(&statsLock);
+    stats_add(&vecStats[pc->input], &stats);
+    pthread_mutex_unlock(&statsLock);
+}
+
+static void *thread_start(void *arg) {
+    (void)arg;
+    char *vecRecords = vec_init(char), *vecOut = vec_init(char);
+    size_t idx = 0;
+
+    while ((idx = __atomic_fetch_add(&nextPiece, 1, __ATOMIC_RELAXED)) < vec_size(vecPieces))
+        piece_process(idx, &vecRecords, &vecOut);
+
+    vec_destroy(vecOut);
+    vec_destroy(vecRecords);
+    return NULL;
+}
+
+static void run_threads(void) {
+    pthread_t tids[threads];
+    nextPiece = 0;
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, thread_start, NULL);
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+}
+
+static bool csv_file_name(const char *name) {
+    const size_t len = strlen(name);
+    return len > 4 && !strcmp(&name[len - 4], ".csv");
+}
+
+static void input_open(const char *name) {
+    if (gzip_file_name(name))
+        DIE("%s: compressed files are not supported (use gzip -d first)\n", name);
+
+    Input in = {.name = name};
+    in.map = file_map(name, &in.size);
+
+    in.format = in.size >= sizeof(SampleMagic) && !memcmp(in.map, SampleMagic, sizeof(SampleMagic))
+                    ? FORMAT_BIN2
+                : csv_file_name(name) ? FORMAT_CSV
+                                      : FORMAT_BIN;
+
+    // Cut in pieces: on line boundaries (csv), record boundaries (bin), or block boundaries (bin2).
+    // Records of bin files have variable sizes, and no marker to resync from an arbitrary offset,
+    // so this reads the size of every record, on the main thread, before any piece is processed.
+    const size_t input = vec_size(vecInputs);
+
+    for (size_t start = 0, end = 0; start < in.size; start = end) {
+        end = min(start + PIECE_SIZE, in.size);
+
+        if (in.format == FORMAT_CSV) {
+            const char *nl = memchr(&in.map[end - 1], '\n', in.size - (end - 1));
+            end = nl ? (size_t)(nl - in.map) + 1 : in.size;
+        } else if (in.format == FORMAT_BIN) {
+            size_t p = start;
+
+            while (p - start < PIECE_SIZE && p + 8 <= in.size) {
+                const size_t bytes = sample_record_size(&in.map[p]);
+
+                if (bytes > in.size - p)
+                    break;
+
+                p += bytes;
+            }
+
+            // End of file, or truncated record (left to the last piece, which reports it)
+            end = p - start >= PIECE_SIZE ? p : in.size;
+        }
+
+        vec_push(vecPieces, ((Piece){.input = input, .start = start, .end = end}));
+    }
+
+    vec_push(vecInputs, in);
+    vec_push(vecStats, ((Stats){.firstInvalid = SIZE_MAX}));
+}
+
+// Format of an output file: -format, otherwise its extension (before .gz), otherwise the format of
+// the first input
+static int output_format(const char *name) {
+    if (outFormat >= 0)
+        return outFormat;
+
+    const size_t len = strlen(name) - (gzip_file_name(name) ? 3 : 0);
+
+    for (int format = FORMAT_BIN2; format >= 0; format--) {
+        const size_t n = strlen(FormatName[format]);
+
+        if (len > n + 1 && name[len - n - 1] == '.' &&
+            !strncmp(&name[len - n], FormatName[format], n))
+            return format;
+    }
+
+    return vecInputs[0].format;
+}
+
+static void output_open(const char *name) {
+    for (size_t i = 0; i < vec_size(vecInputs); i++)
+        if (!strcmp(vecInputs[i].name, name))
+            DIE("%s: cannot be both an input and an output\n", name);
+
+    const bool gz = gzip_file_name(name);
+    const int flags = (outFormat == FORMAT_BIN2 ? ENCODE_BLOCKS : 0) | (gz ? ENCODE_GZIP : 0);
+    const char *fileMode = outFormat == FORMAT_CSV && !gz ? "w" FOPEN_TEXT : "w" FOPEN_BINARY;
+    vec_push(vecWriters, seq_writer_init(name, fileMode, flags, 1000, 1 << 22, 1 << 26));
+}
+
+static void shuffle(const char *outName) {
+    // Buckets small enough to be shuffled in memory by each thread (with a copy, and the output)
+    size_t total = 0;
+
+    for (size_t i = 0; i < vec_size(vecInputs); i++)
+        total += vecInputs[i].size;
+
+    const size_t count = total / max(memory / (size_t)threads / 3, (size_t)PIECE_SIZE) + 1;
+    scope(str_destroy) str_t tmpName = str_init_from_c(outName), bucketName = str_init();
+    str_cat_c(&tmpName, ".tmp");
+    vecBuckets = vec_init_reserve(count, Bucket);
+
+    for (size_t i = 0; i < count; i++) {
+        Bucket b = {.vecBuf = vec_init(char)};
+        pthread_mutex_init(&b.mtx, NULL);
+        shard_file_name(tmpName.buf, (int)i + 1, &bucketName);
+        DIE_IF(!(b.file = fopen(bucketName.buf, "w+" FOPEN_BINARY)));
+        vec_push(vecBuckets, b);
+    }
+
+    mode = MODE_SCATTER;
+    run_threads();
+
+    // Then shuffle each bucket, and write them in order
+    vec_clear(vecPieces);
+
+    for (size_t i = 0; i < count; i++) {
+        Bucket *b = &vecBuckets[i];
+        DIE_IF(fwrite(b->vecBuf, 1, vec_size(b->vecBuf), b->file) != vec_size(b->vecBuf));
+        vec_push(vecPieces, ((Piece){.input = i}));
+    }
+
+    mode = MODE_GATHER;
+    run_threads();
+
+    for (size_t i = 0; i < count; i++) {
+        DIE_IF(fclose(vecBuckets[i].file) < 0);
+        vec_destroy(vecBuckets[i].vecBuf);
+        pthread_mutex_destroy(&vecBuckets[i].mtx);
+        shard_file_name(tmpName.buf, (int)i + 1, &bucketName);
+        DIE_IF(remove(bucketName.buf) < 0);
+    }
+
+    vec_destroy(vecBuckets);
+}
+
+// Compare samples_unpack() with samples_unpack_scalar(), and pos_unpack() of each record, in
+// batches of BATCH samples. Records of all inputs are loaded in memory.
+static void bench(void) {
+    enum { BATCH = 4096, PLANES = NB_COLOR * NB_PIECE };
+    char *vecRecords = vec_init(char);
+    size_t count = 0;
+
+    for (size_t i = 0; i < vec_size(vecPieces); i++) {
+        Stats stats = {.firstInvalid = SIZE_MAX};
+        const size_t start = vec_size(vecRecords);
+        piece_decode(&vecPieces[i], &vecRecords, &stats);
+        records_count(&vecRecords[start], vec_size(vecRecords) - start, &stats);
+        stats_add(&vecStats[vecPieces[i].input], &stats);
+        count += stats.samples;
+    }
+
+    SampleBatch batches[2];
+
+    for (int i = 0; i < 2; i++)
+        batches[i] = (SampleBatch){.planes = calloc(PLANES * BATCH, sizeof(bitboard_t)),
+                                   .scores = calloc(BATCH, sizeof(int16_t)),
+                                   .results = calloc(BATCH, 1),
+                                   .turns = calloc(BATCH, 1)};
+
+    // Check that all methods agree
+    for (size_t i = 0, offset = 0; i < count; i += BATCH) {
+        const size_t n = min((size_t)BATCH, count - i);
+        const SampleBatch *b = &batches[0], *ref = &batches[1];
+        const size_t bytes = samples_unpack(&vecRecords[offset], n, b);
+
+        if (samples_unpack_scalar(&vecRecords[offset], n, ref) != bytes ||
+            memcmp(b->planes, ref->planes, PLANES * n * sizeof(bitboard_t)) ||
+            memcmp(b->scores, ref->scores, n * sizeof(int16_t)) ||
+            memcmp(b->results, ref->results, n) || memcmp(b->turns, ref->turns, n))
+            DIE("samples_unpack() and samples_unpack_scalar() differ\n");
+
+        for (size_t j = 0; j < n; j++) {
+            const size_t bytesJ = sample_record_size(&vecRecords[offset]);
+            Position pos = {0};
+            record_unpack(&vecRecords[offset], bytesJ, &pos);
+
+            for (int color = WHITE; color <= BLACK; color++)
+                for (int piece = KNIGHT; piece <= PAWN; piece++)
+                    if (pos_pieces_cp(&pos, color, piece) !=
+                        ref->planes[(size_t)(NB_PIECE * color + piece) * n + j])
+                        DIE("samples_unpack_scalar() and pos_unpack() differ\n");
+
+            offset += bytesJ;
+        }
+    }
+
+    // Then time them, on about 10^7 samples at least
+    const size_t reps = 10000000 / max(count, (size_t)1) + 1;
+    const char *names[] = {"pos_unpack", "samples_unpack_scalar", "samples_unpack"};
+    uint64_t sink = 0;
+
+    for (int method = 0; method < 3; method++) {
+        const int64_t start = system_msec();
+
+        for (size_t r = 0; r < reps; r++)
+            for (size_t i = 0, offset = 0; i < count; i += BATCH) {
+                const size_t n = min((size_t)BATCH, count - i);
+
+                if (method == 2)
+                    offset += samples_unpack(&vecRecords[offset], n, &batches[0]);
+                else if (method == 1)
+                    offset += samples_unpack_scalar(&vecRecords[offset], n, &batches[0]);
+                else
+                    for (size_t j = 0; j < n; j++) {
+                        PackedPos pp = {0};
+                        const size_t bytes = sample_record_size(&vecRecords[offset]);
+                        memcpy(&pp, &vecRecords[offset], bytes - 3);
+
+                        Position pos;
+                        pos_unpack(&pos, &pp);
+                        sink += pos.key;
+                        offset += bytes;
+                    }
+
+                sink += batches[0].planes[i % BATCH];
+            }
+
+        const int64_t elapsed = max(system_msec() - start, (int64_t)1);
+        printf("%-22s %.0f samples/s\n", names[method], (double)(count * reps) * 1000 / elapsed);
+    }
+
+    printf("samples_unpack() uses %s (checksum %" PRIx64 ")\n",
+#ifdef __BMI2__
+           "pdep and SIMD",
+#else
+           "the scalar loop",
+#endif
+           sink);
+
+    for (int i = 0; i < 2; i++) {
+        free(batches[i].planes);
+        free(batches[i].scores);
+        free(batches[i].results);
+        free(batches[i].turns);
+    }
+
+    vec_destroy(vecRecords);
+}
+
+static void usage(void) {
+    puts("usage: c-chess-samples [-threads N] [-format csv|bin|bin2] [-seed N] [-mem MB] COMMAND\n"
+         "  validate FILE...       check every sample, and print statistics\n"
+         "  convert IN OUT         convert IN to the format of OUT (or -format)\n"
+         "  merge OUT IN...        concatenate files\n"
+         "  split IN OUT N         split IN in N files OUT (with .1 .. .N before the extension)\n"
+         "  shuffle OUT IN...      concatenate and shuffle files\n"
+         "  bench FILE...          benchmark decoding of samples into bitboards");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char **argv) {
+    int i = 1;
+    threads = system_cpus();
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-threads"))
+            threads = max(atoi(argv[i + 1]), 1);
+        else if (!strcmp(argv[i], "-seed"))
+            seed = (uint64_t)atoll(argv[i + 1]);
+        else if (!strcmp(argv[i], "-mem"))
+            memory = (size_t)atoll(argv[i + 1]) << 20;
+        else if (!strcmp(argv[i], "-format")) {
+            for (outFormat = FORMAT_BIN2; outFormat >= 0; outFormat--)
+                if (!strcmp(argv[i + 1], FormatName[outFormat]))
+                    break;
+
+            if (outFormat < 0)
+                DIE("Illegal format: '%s'\n", argv[i + 1]);
+        } else
+            usage();
+    }
+
+    if (i >= argc)
+        usage();
+
+    const char *command = argv[i++];
+    const char **args = &argv[i];
+    const int n = argc - i;
+    const int64_t start = system_msec();
+
+    vecInputs = vec_init(Input);
+    vecPieces = vec_init(Piece);
+    vecStats = vec_init(Stats);
+    vecWriters = vec_init(SeqWriter);
+
+    if (!strcmp(command, "validate") && n >= 1) {
+        for (int j = 0; j < n; j++)
+            input_open(args[j]);
+
+        mode = MODE_VALIDATE;
+        run_threads();
+    } else if (!strcmp(command, "bench") && n >= 1) {
+        for (int j = 0; j < n; j++)
+            input_open(args[j]);
+
+        mode = MODE_BENCH;
+        bench();
+    } else if ((!strcmp(command, "merge") || !strcmp(command, "shuffle")) && n >= 2) {
+        for (int j = 1; j < n; j++)
+            input_open(args[j]);
+
+        outFormat = output_format(args[0]);
+        output_open(args[0]);
+
+        if (!strcmp(command, "shuffle"))
+            shuffle(args[0]);
+        else {
+            mode = MODE_WRITE;
+            run_threads();
+        }
+    } else if ((!strcmp(command, "convert") && n == 2) ||
+               (!strcmp(command, "split") && n == 3 && atoi(args[2]) >= 1)) {
+        input_open(args[0]);
+        outFormat = output_format(args[1]);
+
+        if (!strcmp(command, "split")) {
+            scope(str_destroy) str_t name = str_init();
+
+            for (int j = 1; j <= atoi(args[2]); j++) {
+                shard_file_name(args[1], j, &name);
+                output_open(name.buf);
+            }
+        } else
+            output_open(args[1]);
+
+        mode = MODE_WRITE;
+        run_threads();
+    } else
+        usage();
+
+    vec_destroy_rec(vecWriters, seq_writer_destroy);
+
+    // Statistics, by input
+    bool ok = true;
+    uint64_t total = 0;
+
+    for (size_t j = 0; j < vec_size(vecInputs); j++) {
+        const Stats *s = &vecStats[j];
+        printf("%s: %s, %" PRIu64 " samples (loss %" PRIu64 ", draw %" PRIu64 ", win %" PRIu64 ")",
+               vecInputs[j].name, FormatName[vecInputs[j].format], s->samples, s->results[0],
+               s->results[1], s->results[2]);
+
+        if (s->invalid)
+            printf(", %" PRIu64 " invalid (first at offset %zu)", s->invalid, s->firstInvalid);
+
+        puts("");
+        ok &= !s->invalid;
+        total += s->samples;
+        file_unmap(vecInputs[j].map, vecInputs[j].size);
+    }
+
+    // Bench prints its own speed, per method
+    if (mode != MODE_BENCH) {
+        const int64_t elapsed = max(system_msec() - start, (int64_t)1);
+        printf("%" PRIu64 " samples in %.3fs (%.0f samples/s)\n", total, elapsed / 1000.0,
+               total * 1000.0 / elapsed);
+    }
+
+    vec_destroy(vecStats);
+    vec_destroy(vecPieces);
+    vec_destroy(vecInputs);
+    return ok ? 0 : 1;
+}